@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
   int
@@ -27,6 +30,26 @@ _get_path(void)
   return _path;
 }  
 
+  char*
+arch_read_line(FILE* file, char** line, size_t* size)
+{
+  size_t length = 0;
+  while (fgets(*line + length, *size - length, file)) {
+    length += strlen(*line + length);
+    if (length > 0 && (*line)[length-1] == '\n') {
+      return *line;
+    }
+    // Out of memory, the caller still owns and frees the old buffer
+    char* grown = realloc(*line, *size * 2);
+    if (grown == NULL) {
+      return NULL;
+    }
+    *line = grown;
+    *size *= 2;
+  }
+  return length > 0 ? *line : NULL;
+}
+
   int
 arch_load(char* name, arch_load_out_cb cb, void* context)
 {
@@ -36,10 +59,12 @@ arch_load(char* name, arch_load_out_cb cb, void* context)
   if(!fp){
     return 1;
   }
-  char line[256];
-  while(fgets(line, 256, fp) != NULL) {
+  size_t size = 256;
+  char* line = malloc(size);
+  while(arch_read_line(fp, &line, &size) != NULL) {
     cb(line, context);
   }
+  free(line);
   fclose(fp);
   free(filename);
   return 0;
@@ -107,4 +132,68 @@ arch_delete(char* name){
   return 0;
 }
 
+  int
+arch_save_image(char* name, arch_image_part* parts, size_t count)
+{
+  // Write next to the image and rename, the old one may still be mapped
+  char* filename;
+  char* temporary;
+  asprintf(&filename, "%s/%s.img", _get_path(), name);
+  asprintf(&temporary, "%s.tmp", filename);
+  int rv = 1;
+  FILE* fp = fopen(temporary, "wb");
+  if(fp){
+    rv = 0;
+    for(size_t i=0; i<count; i++){
+      if (fwrite(parts[i].data, 1, parts[i].size, fp) != parts[i].size){
+        rv = 1;
+      }
+    }
+    if (fclose(fp) != 0){
+      rv = 1;
+    }
+    if (rv == 0 && rename(temporary, filename) != 0){
+      rv = 1;
+    }
+    if (rv != 0){
+      remove(temporary);
+    }
+  }
+  free(temporary);
+  free(filename);
+  return rv;
+}
+
+/*
+  The image is mapped private and writable, pages are only copied when the
+  program is edited.
+*/
+  char*
+arch_map_image(char* name, size_t* size)
+{
+  char* filename;
+  asprintf(&filename, "%s/%s.img", _get_path(), name);
+  int fd = open(filename, O_RDONLY);
+  free(filename);
+  if (fd < 0){
+    return NULL;
+  }
+  struct stat stats;
+  if (fstat(fd, &stats) != 0 || stats.st_size == 0){
+    close(fd);
+    return NULL;
+  }
+  void* image = mmap(NULL, stats.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED){
+    return NULL;
+  }
+  *size = stats.st_size;
+  return image;
+}
 
+  void
+arch_unmap_image(char* image, size_t size)
+{
+  munmap(image, size);
+}
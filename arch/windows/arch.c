@@ -27,6 +27,26 @@ _get_path(void)
   return _path;
 }  
 
+  char*
+arch_read_line(FILE* file, char** line, size_t* size)
+{
+  size_t length = 0;
+  while (fgets(*line + length, *size - length, file)) {
+    length += strlen(*line + length);
+    if (length > 0 && (*line)[length-1] == '\n') {
+      return *line;
+    }
+    // Out of memory, the caller still owns and frees the old buffer
+    char* grown = realloc(*line, *size * 2);
+    if (grown == NULL) {
+      return NULL;
+    }
+    *line = grown;
+    *size *= 2;
+  }
+  return length > 0 ? *line : NULL;
+}
+
   int
 arch_load(char* name, arch_load_out_cb cb, void* context)
 {
@@ -36,10 +56,12 @@ arch_load(char* name, arch_load_out_cb cb, void* context)
   if(!fp){
     return 1;
   }
-  char line[256];
-  while(fgets(line, 256, fp) != NULL) {
+  size_t size = 256;
+  char* line = malloc(size);
+  while(arch_read_line(fp, &line, &size) != NULL) {
     cb(line, context);
   }
+  free(line);
   fclose(fp);
   free(filename);
   return 0;
@@ -107,4 +129,56 @@ arch_delete(char* name){
   return 0;
 }
 
+  int
+arch_save_image(char* name, arch_image_part* parts, size_t count)
+{
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/%s.img", _get_path(), name);
+  FILE* fp = fopen(filename, "wb");
+  if(!fp){
+    return 1;
+  }
+  int rv = 0;
+  for(size_t i=0; i<count; i++){
+    if (fwrite(parts[i].data, 1, parts[i].size, fp) != parts[i].size){
+      rv = 1;
+    }
+  }
+  if (fclose(fp) != 0){
+    rv = 1;
+  }
+  return rv;
+}
+
+/*
+  No mapping here, the image is read into memory of its own.
+*/
+  char*
+arch_map_image(char* name, size_t* size)
+{
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/%s.img", _get_path(), name);
+  FILE* fp = fopen(filename, "rb");
+  if(!fp){
+    return NULL;
+  }
+  fseek(fp, 0, SEEK_END);
+  long length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char* image = length > 0 ? malloc(length) : NULL;
+  if (image != NULL && fread(image, 1, length, fp) != (size_t) length){
+    free(image);
+    image = NULL;
+  }
+  fclose(fp);
+  if (image != NULL){
+    *size = length;
+  }
+  return image;
+}
 
+  void
+arch_unmap_image(char* image, size_t size)
+{
+  free(image);
+}
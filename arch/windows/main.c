@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 //#include <readline/readline.h>
 //#include <readline/history.h>
@@ -7,6 +8,7 @@
 #include <stdbool.h>
 
 #include "parser.h"
+#include "arch.h"
 
 extern bool __RUNNING;
 extern bool __STOPPED;
@@ -86,8 +88,9 @@ void run(char *file_name){
     return;  
   }  
 
-  char line[tokenizer_string_length];
-  while (fgets(line, sizeof(line), file)) {
+  size_t size = 128;
+  char* line = malloc(size);
+  while (arch_read_line(file, &line, &size)) {
     if(line[strlen(line)-1]!='\n')
     {
       printf("ERROR: NO EOL\n");
@@ -95,6 +98,7 @@ void run(char *file_name){
     }
     basic_eval(line);
   }
+  free(line);
   fclose(file);
 
   basic_run();
@@ -23,6 +23,7 @@ extern uint16_t __line;
 extern bool __STOPPED;
 
 extern token sym;
+extern tokenizer_state __tokenizer;
 extern bool accept(token t);
 extern void get_sym(void);
 static token t_keyword_batch;
@@ -377,7 +378,7 @@ batch(char *filename)
 {
   FIL fil;
   FRESULT fr;
-  char line[tokenizer_string_length];
+  char line[64];
   fr = f_open(&fil, filename, FA_READ);
   if(fr) return;
   while (f_gets(line, sizeof line, &fil)){
@@ -395,10 +396,11 @@ do_batch(basic_type* rv)
     error("EXPECTED LITERAL STRING");
     return 0;
   }
-  char *name = tokenizer_get_string();
+  slice name = tokenizer_get_string(&__tokenizer);
   accept(T_STRING);
-  strncpy(filename,name,9);
-  strcat(filename,".BAS");
+  size_t length = name.length < 8 ? name.length : 8;
+  memcpy(filename,name.string,length);
+  strcpy(&filename[length],".BAS");
   batch(filename);
   return 0;
 }
@@ -26,4 +26,20 @@ int arch_dir(arch_dir_out_cb cb, void* context);
 
 int arch_delete(char* filename);
 
+#if defined(_WIN32) || ARCH!=ARCH_XMEGA
+#include <stdio.h>
+// Read a whole line, however long, growing the buffer as needed
+char* arch_read_line(FILE* file, char** line, size_t* size);
+#endif
+
+// Program images, written in parts and mapped copy-on-write where possible
+typedef struct {
+  void* data;
+  size_t size;
+} arch_image_part;
+
+int arch_save_image(char* filename, arch_image_part* parts, size_t count);
+char* arch_map_image(char* filename, size_t* size);
+void arch_unmap_image(char* image, size_t size);
+
 #endif // __ARCH_H__
@@ -0,0 +1,26 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdlib.h>
+
+typedef struct arena arena;
+typedef struct arena_chunk arena_chunk;
+
+typedef struct {
+  arena_chunk* chunk;
+  size_t used;
+} arena_mark;
+
+arena* arena_new(size_t chunk_size);
+
+void arena_destroy(arena* arena);
+
+void* arena_alloc(arena* arena, size_t size);
+
+char* arena_strndup(arena* arena, char* string, size_t length);
+
+arena_mark arena_get_mark(arena* arena);
+
+void arena_reset(arena* arena, arena_mark mark);
+
+#endif // __ARENA_H__
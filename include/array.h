@@ -1,6 +1,10 @@
 #ifndef __ARRAY_H__
 #define __ARRAY_H__
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
 typedef struct array array;
 
 array* array_new(size_t element_size);
@@ -17,5 +21,12 @@ void* array_set(array* array, size_t index, void* value);
 
 size_t array_size(array* array);
 
+// Packed bits, eight to a byte, for flags in a block of their own
+size_t array_bits_bytes(size_t bits);
+
+bool array_bit_get(uint8_t* bits, size_t index);
+
+void array_bit_set(uint8_t* bits, size_t index, bool value);
+
 
 #endif // __ARRAY_H__
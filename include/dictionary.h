@@ -3,12 +3,18 @@
 
 #include <stdbool.h>
 
+#include "arena.h"
+
 typedef struct dictionary dictionary;
 
 typedef void (*dictionary_each_cb)(char* name, void* value, void* context);
 
 dictionary* dictionary_new(void);
+// Names are copied into the arena, they go when it is reset
+dictionary* dictionary_new_in(arena* names);
 void dictionary_destroy(dictionary* d, dictionary_each_cb cb);
+// Remove all entries, cb is called for each of them first
+void dictionary_clear(dictionary* d, dictionary_each_cb cb);
 void dictionary_put(dictionary* d, char* name, void* value);
 bool dictionary_has(dictionary* d, char* name);
 void* dictionary_get(dictionary* d, char* name);
@@ -0,0 +1,26 @@
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <stdbool.h>
+
+#include "lines.h"
+
+#ifdef LINES_GROWABLE
+
+typedef enum {
+  image_ok,
+  image_io_error,
+  image_invalid,
+  image_incompatible,
+  image_out_of_memory
+} image_status;
+
+// Write the program as an image, with a crunched or an expanded body
+image_status image_save(char* filename, bool crunched);
+
+// Replace the program with an image, its memory becomes program memory
+image_status image_load(char* filename);
+
+#endif
+
+#endif // __IMAGE_H__
@@ -4,23 +4,91 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// Lines can be up to 64 KB, the xmega keeps a one byte length
+#ifndef _WIN32
+#  if ARCH!=ARCH_XMEGA
+#    define LINES_LONG
+#  endif
+#else
+#  define LINES_LONG
+#endif
+
+// Maximum size of the contents of a line, including the terminating '\0'
+#ifdef LINES_LONG
+typedef uint16_t line_length;
+#define lines_max_length UINT16_MAX
+#else
+typedef uint8_t line_length;
+#define lines_max_length UINT8_MAX
+#endif
+
 typedef struct line line;
 
 struct line
 {
-  uint16_t  number;
-  uint8_t   length;
-  char      contents;
+  uint16_t    number;
+  line_length length;
+  char        contents;
 };
 
+// Program memory grows on demand, except on the xmega which keeps the
+// single block it is given
+#ifndef _WIN32
+#  if ARCH!=ARCH_XMEGA
+#    define LINES_GROWABLE
+#  endif
+#else
+#  define LINES_GROWABLE
+#endif
+
+// Store the program in a fixed block of memory, owned by the caller
 void lines_init(char *memory, size_t memory_size);
 
+#ifdef LINES_GROWABLE
+// Store the program in memory of its own, starting at memory_size and
+// growing in chunks when it fills up
+bool lines_init_growable(size_t memory_size);
+
+// Don't grow program memory past limit bytes, 0 means no limit
+void lines_set_limit(size_t limit);
+
+// Move all lines to the start of program memory, for writing a program
+// image. Returns the size of the packed lines, the image is these bytes
+// followed by an empty sentinel line.
+size_t lines_pack(char** memory);
+
+// Use memory holding a program image as program memory. It is released
+// with release when it is swapped for memory of our own. Returns false,
+// with the program cleared, when it doesn't hold a valid program.
+typedef void (*lines_release_cb)(void);
+bool lines_adopt(char* memory, size_t memory_size, lines_release_cb release);
+#endif
+
+void lines_destroy(void);
+
 size_t lines_memory_used(void);
+// Room left before program memory has to grow (or is full)
 size_t lines_memory_available(void);
 
 bool lines_delete(uint16_t number);
 
 bool lines_store(uint16_t number, char* contents );
+
+// Delete the lines from start to end (0 is the last line) in one go,
+// returns how many were deleted
+size_t lines_delete_range(uint16_t start, uint16_t end);
+
+typedef struct
+{
+  uint16_t number;
+  char* contents;
+} lines_entry;
+
+bool lines_load(lines_entry* entries, size_t count);
+
+// Store a batch of lines in one pass, empty contents delete a line. Returns
+// false, with the program as it was, when they don't fit.
+bool lines_merge(lines_entry* entries, size_t count);
  
 typedef void (*lines_list_cb)(uint16_t number, char* contents);
  
@@ -33,4 +101,25 @@ char* lines_get_contents(uint16_t number);
 uint16_t lines_first(void);
 uint16_t lines_next(uint16_t number);
 
+/*
+  A cursor walks the program in line number order. Moving to the next line
+  is O(1) as long as the program isn't changed, after a change the cursor
+  finds its place again from its line number. number and contents are 0
+  and NULL when the cursor is past the last line.
+*/
+typedef struct
+{
+  uint16_t number;
+  char* contents;
+  size_t position;
+  uint32_t generation;
+} lines_cursor;
+
+bool lines_cursor_first(lines_cursor* cursor);
+bool lines_cursor_next(lines_cursor* cursor);
+bool lines_cursor_seek(lines_cursor* cursor, uint16_t number);
+
+// Changes on every store, delete or clear, cached views on the program compare it
+uint32_t lines_generation(void);
+
 #endif // __LINES_H__
@@ -0,0 +1,63 @@
+#ifndef __NUMBER_H__
+#define __NUMBER_H__
+
+#include <stdlib.h>
+#include <math.h>
+
+/*
+  The type BASIC numbers have. Hosts compute in double, the XMEGA keeps
+  float. A build picks one with -DBASIC_NUMBER_FLOAT or
+  -DBASIC_NUMBER_DOUBLE.
+
+  The number_* wrappers call the math function of the chosen type, so
+  nothing is converted on the way.
+*/
+
+#if !defined(BASIC_NUMBER_FLOAT) && !defined(BASIC_NUMBER_DOUBLE)
+#  ifndef _WIN32
+#    if ARCH!=ARCH_XMEGA
+#      define BASIC_NUMBER_DOUBLE
+#    else
+#      define BASIC_NUMBER_FLOAT
+#    endif
+#  else
+#    define BASIC_NUMBER_DOUBLE
+#  endif
+#endif
+
+#ifdef BASIC_NUMBER_FLOAT
+
+typedef float basic_number;
+
+// Significant digits that read back as the same number
+#define NUMBER_DIGITS 9
+
+#define number_strto strtof
+#define number_sqrt sqrtf
+#define number_sin sinf
+#define number_cos cosf
+#define number_tan tanf
+#define number_atan atanf
+#define number_log logf
+#define number_exp expf
+#define number_pow powf
+
+#else
+
+typedef double basic_number;
+
+#define NUMBER_DIGITS 17
+
+#define number_strto strtod
+#define number_sqrt sqrt
+#define number_sin sin
+#define number_cos cos
+#define number_tan tan
+#define number_atan atan
+#define number_log log
+#define number_exp exp
+#define number_pow pow
+
+#endif
+
+#endif // __NUMBER_H__
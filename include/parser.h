@@ -3,14 +3,15 @@
 
 #include <tokenizer.h>
 #include <io.h>
+#include <number.h>
 
 #include <stdbool.h>
 
-float evaluate(char *expression_string);
+basic_number evaluate(char *expression_string);
 
 void evaluate_print(char *line);
 
-void evaluate_print_func_param( char *func, float param);
+void evaluate_print_func_param( char *func, basic_number param);
 
 const char* evaluate_last_error(void);
 void clear_last_error(void);
@@ -28,7 +29,7 @@ void basic_run(void);
 
 // For extensions
 
-typedef float (*function)(float number);
+typedef basic_number (*function)(basic_number number);
 
 typedef struct
 {
@@ -50,7 +51,7 @@ typedef enum {
 } kind;
 
 typedef union {
-  float number;
+  basic_number number;
   char* string;
 } value;
 
@@ -0,0 +1,12 @@
+#ifndef __SLICE_H__
+#define __SLICE_H__
+
+#include <stdlib.h>
+
+// A (pointer, length) view on a string, not necessarily '\0' terminated.
+typedef struct {
+  char* string;
+  size_t length;
+} slice;
+
+#endif // __SLICE_H__
@@ -2,9 +2,11 @@
 #define __TOKENIZER_H__
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
 
-#define tokenizer_string_length 64 
-#define tokenizer_variable_length 8
+#include "slice.h"
+#include "number.h"
 
 typedef unsigned int token;
 typedef char* token_name;
@@ -44,21 +46,69 @@ typedef enum {
   TOKEN_TYPE_END
 } token_type;
 
+typedef struct tokenizer_line tokenizer_line;
+
+typedef struct {
+  char* line;
+  char* p;
+  char* next_p;
+  basic_number number;
+  slice string;
+  slice variable;
+  size_t variable_index; // interned index of the variable name
+  size_t keyword_index;
+  tokenizer_line* cached; // replaying the decoded tokens of a program line
+  size_t index;
+  bool crunched; // reading a stored line, decode crunched codes
+} tokenizer_state;
+
+// A place in the token stream of a line to come back to without lexing
+typedef struct {
+  char* line;
+  char* p;
+  tokenizer_line* cached;
+  size_t index;
+  bool crunched;
+} tokenizer_position;
+
 void tokenizer_setup(void);
-void tokenizer_init(char *input);
-token tokenizer_get_next_token(void);
+void tokenizer_init(tokenizer_state* state, char *input);
+// Read a stored, crunched program line
+void tokenizer_init_crunched(tokenizer_state* state, char *input);
+token tokenizer_get_next_token(tokenizer_state* state);
 
-float tokenizer_get_number(void);
-char * tokenizer_get_string(void);
-void tokenizer_get_variable_name(char *name);
+basic_number tokenizer_get_number(tokenizer_state* state);
+slice tokenizer_get_string(tokenizer_state* state);
+slice tokenizer_get_variable_name(tokenizer_state* state);
+
+// Variables lexed from plain text have no interned index
+#define TOKENIZER_NOT_INTERNED ((size_t) -1)
+size_t tokenizer_get_variable_index(tokenizer_state* state);
 
 char *tokenizer_token_name(token);
 
-char* tokenizer_char_pointer(char* set);
+char* tokenizer_char_pointer(tokenizer_state* state, char* set);
 
 void tokenizer_add_tokens( token_entry* tokens );
 
 void tokenizer_register_token( token_entry* entry );
 void tokenizer_free_registered_tokens(void);
 
+bool tokenizer_crunch(char* input, char* output, size_t output_size);
+bool tokenizer_expand(char* input, char* output, size_t output_size);
+void tokenizer_clear_variables(void);
+
+// The tables behind crunched lines, the names are NULL past the last entry
+char* tokenizer_variable_name(size_t index);
+size_t tokenizer_intern_variable(char* name);
+char* tokenizer_crunched_keyword(size_t index);
+
+bool tokenizer_cache_lookup(tokenizer_state* state, uint16_t number, uint32_t generation);
+void tokenizer_cache_store(tokenizer_state* state, uint16_t number, char* contents, uint32_t generation);
+void tokenizer_cache_clear(void);
+
+tokenizer_position tokenizer_get_position(tokenizer_state* state);
+// Returns false when the position can't be replayed any more
+bool tokenizer_set_position(tokenizer_state* state, tokenizer_position* position, uint32_t generation);
+
 #endif // __TOKENIZER_H__
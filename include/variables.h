@@ -2,37 +2,79 @@
 #define __VARIABLES_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "slice.h"
+#include "number.h"
 
 typedef enum {
   variable_type_unknown,
   variable_type_numeric,
-  variable_type_string
+  variable_type_string,
+  variable_type_integer,
+  variable_type_byte,
+  variable_type_bit
 } variable_type;
 
 typedef struct variable variable;
 
 bool variables_init(void);
 void variables_destroy(void);
+// Forget all variables, as CLEAR and NEW do
+void variables_clear(void);
 
 variable* variable_get(char* name);
 
+// Bind a variable to the slot of its interned name, a scalar is created on
+// first use. Names from plain text have no slot and are looked up by name.
+#define VARIABLE_NO_SLOT ((size_t) -1)
+variable* variable_bind(size_t slot, slice name, bool is_array);
+void variables_unbind(void);
+
+basic_number variable_numeric(variable* var);
+void variable_store_numeric(variable* var, basic_number value);
+// Stays valid until the variables are cleared
+basic_number* variable_numeric_storage(variable* var);
+
+// Integer variables (A%) hold an int32_t, numbers stored in them are
+// truncated. The numeric functions convert for them and the other way
+// around.
+int32_t variable_integer(variable* var);
+void variable_store_integer(variable* var, int32_t value);
+int32_t* variable_integer_storage(variable* var);
+int32_t variable_float_to_integer(basic_number value);
+
+// The type a name asks for by its last character: $ string, % integer,
+// @ byte and ! bit, numeric otherwise. Only arrays store bytes and bits,
+// a scalar of such a name is an integer.
+variable_type variable_name_type(slice name);
+char* variable_string(variable* var);
+void variable_store_string(variable* var, slice value);
+
+basic_number variable_element_numeric(variable* var, size_t* vector);
+void variable_store_element_numeric(variable* var, basic_number value, size_t* vector);
+int32_t variable_element_integer(variable* var, size_t* vector);
+void variable_store_element_integer(variable* var, int32_t value, size_t* vector);
+char* variable_element_string(variable* var, size_t* vector);
+void variable_store_element_string(variable* var, slice value, size_t* vector);
+
 char* variable_get_string(char* name);
-float variable_get_numeric(char* name);
+basic_number variable_get_numeric(char* name);
 
-variable* variable_set_string(char* name, char* value);
-variable* variable_set_numeric(char* name, float value); 
+variable* variable_set_string(char* name, slice value);
+variable* variable_set_numeric(char* name, basic_number value); 
 
 variable_type variable_get_type(char* name);
 
 variable* variable_array_init(char* name, variable_type type, size_t dimensions, size_t* vector);
-variable* variable_array_set_string(char *name, char *value, size_t* vector);
+variable* variable_array_set_string(char *name, slice value, size_t* vector);
 char* variable_array_get_string(char *name, size_t* vector);
-variable* variable_array_set_numeric(char *name, float value, size_t* vector);
-float variable_array_get_numeric(char *name, size_t* vector);
+variable* variable_array_set_numeric(char *name, basic_number value, size_t* vector);
+basic_number variable_array_get_numeric(char *name, size_t* vector);
 
-typedef void (*variables_each_cb)(variable* var, void* context);
+typedef void (*variables_each_cb)(char* name, variable* var, void* context);
 void variables_each(variables_each_cb each, void* context);
 
-void variable_dump(variable* var);
+void variable_dump(char* name, variable* var);
 
 #endif // __VARIABLES_H__
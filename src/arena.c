@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+  A scratch arena hands out memory from a list of chunks. Allocations
+  never move, so pointers stay valid until the arena is reset to a mark
+  taken before them. Chunks are kept after a reset and reused by the
+  following allocations.
+*/
+
+#define ARENA_ALIGN sizeof(void*)
+
+struct arena_chunk {
+  arena_chunk* next;
+  size_t size;
+  size_t used;
+  char* data;
+};
+
+struct arena {
+  size_t chunk_size;
+  arena_chunk* first;
+  arena_chunk* current;
+};
+
+  static arena_chunk*
+_chunk_new(size_t size)
+{
+  arena_chunk* chunk = malloc(sizeof(arena_chunk) + size);
+  if (chunk == NULL)
+  {
+    return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->data = (char*) (chunk + 1);
+  return chunk;
+}
+
+  arena*
+arena_new(size_t chunk_size)
+{
+  arena* a = malloc(sizeof(arena));
+  a->chunk_size = chunk_size;
+  a->first = _chunk_new(chunk_size);
+  a->current = a->first;
+  return a;
+}
+
+  void
+arena_destroy(arena* arena)
+{
+  arena_chunk* chunk = arena->first;
+  while (chunk)
+  {
+    arena_chunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+}
+
+  void*
+arena_alloc(arena* arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  arena_chunk* chunk = arena->current;
+  while (chunk->used + size > chunk->size)
+  {
+    arena_chunk* next = chunk->next;
+    if (next == NULL || next->size < size)
+    {
+      // Splice in a fresh chunk, big enough for this allocation
+      size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+      arena_chunk* fresh = _chunk_new(chunk_size);
+      if (fresh == NULL)
+      {
+        return NULL;
+      }
+      fresh->next = next;
+      chunk->next = fresh;
+      next = fresh;
+    }
+    next->used = 0;
+    chunk = next;
+  }
+
+  arena->current = chunk;
+  void* p = chunk->data + chunk->used;
+  chunk->used += size;
+  return p;
+}
+
+  char*
+arena_strndup(arena* arena, char* string, size_t length)
+{
+  char* copy = arena_alloc(arena, length + 1);
+  if (copy == NULL)
+  {
+    return NULL;
+  }
+  memcpy(copy, string, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+  arena_mark
+arena_get_mark(arena* arena)
+{
+  arena_mark mark;
+  mark.chunk = arena->current;
+  mark.used = arena->current->used;
+  return mark;
+}
+
+  void
+arena_reset(arena* arena, arena_mark mark)
+{
+  arena->current = mark.chunk;
+  arena->current->used = mark.used;
+}
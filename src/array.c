@@ -9,6 +9,7 @@
 struct array {
   size_t element_size;
   size_t size;
+  size_t capacity;
   char* ptr;
 };
 
@@ -19,6 +20,7 @@ array_new(size_t element_size)
   array* a = malloc(sizeof(array));  
   a->element_size = element_size;
   a->size = 0;
+  a->capacity = 0;
   a->ptr = NULL;
   return a;
 }
@@ -27,6 +29,7 @@ array_new(size_t element_size)
 array_alloc(array* array, size_t size)
 {
   array->size = size;
+  array->capacity = size;
   array->ptr = realloc(array->ptr, array->element_size * array->size);
   // Always clear arrays
   memset(array->ptr, 0, array->element_size * array->size);
@@ -44,7 +47,12 @@ array_destroy(array* array)
 array_push(array* array, void* value)
 {
   array->size++;
-  array->ptr = realloc(array->ptr, array->element_size * array->size);
+  if ( array->size > array->capacity )
+  {
+    // Grow by doubling, pushing n elements costs O(n) copies
+    array->capacity = array->capacity ? array->capacity * 2 : 4;
+    array->ptr = realloc(array->ptr, array->element_size * array->capacity);
+  }
   void* element = array->ptr + array->element_size * (array->size - 1);
   memcpy(element, value, array->element_size);
   return element;
@@ -70,3 +78,28 @@ array_size(array* array)
   return array->size;
 }
 
+  size_t
+array_bits_bytes(size_t bits)
+{
+  return (bits + 7) / 8;
+}
+
+  bool
+array_bit_get(uint8_t* bits, size_t index)
+{
+  return ( bits[index / 8] >> (index % 8) ) & 1;
+}
+
+  void
+array_bit_set(uint8_t* bits, size_t index, bool value)
+{
+  uint8_t mask = 1 << (index % 8);
+  if (value)
+  {
+    bits[index / 8] |= mask;
+  }
+  else
+  {
+    bits[index / 8] &= ~mask;
+  }
+}
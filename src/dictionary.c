@@ -1,65 +1,110 @@
 #define _GNU_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
-#include <stdlib.h>
 #include <stdio.h>
 
 #include <dictionary.h>
+#include <arena.h>
 #include "usingwin.h"
 
-typedef struct entry entry;
-struct entry
+/*
+  Open addressing with linear probing. A slot keeps the hash of its name,
+  a probe only compares names when the hashes match. The table doubles
+  when it gets 3/4 full. Deleting shifts the following entries of the
+  probe sequence back, so there are no tombstones and a lookup stops at
+  the first empty slot.
+
+  A dictionary made with dictionary_new_in() copies its names into an
+  arena owned by the caller and never frees them one by one.
+*/
+
+typedef struct
 {
-    entry* next;
-    char* name;
-    void* value;
-};
+  uint32_t hash;
+  char* name;
+  void* value;
+} slot;
 
 #ifndef _WIN32
 #if ARCH!=ARCH_XMEGA
-#   define HASHSIZE 13
+#   define INITIAL_CAPACITY 16
 #else
-#   define HASHSIZE 101
+#   define INITIAL_CAPACITY 8
 #endif
 #else
-#   define HASHSIZE 13
+#   define INITIAL_CAPACITY 16
 #endif
 
 struct dictionary {
-  entry *hashtab[HASHSIZE];
+  slot* slots;
+  size_t capacity;
+  size_t count;
+  arena* names;
 };
 
-static unsigned int
+static uint32_t
 hash(char *name)
 {
-    unsigned int hashval;
-    for (hashval = 0; *name != '\0'; name++) {
-      hashval = *name + 31 * hashval;
+    // FNV-1a
+    uint32_t hashval = 2166136261UL;
+    for (; *name != '\0'; name++) {
+      hashval ^= (unsigned char) *name;
+      hashval *= 16777619UL;
     }
-    return hashval % HASHSIZE;
+    return hashval;
 }
 
-static entry* _get(dictionary* d, char *name)
+/*
+  The slot holding name, or the empty slot where it would go.
+*/
+static size_t
+_find(dictionary* d, char *name, uint32_t hashval)
 {
-  // printf("get %p %s\n", d, name);
-  entry* entry;
-  for (entry = d->hashtab[hash(name)]; entry != NULL; entry = entry->next) {
-    if (strcmp(name, entry->name) == 0) {
-      // printf("\tgot %p\n", entry);
-      return entry;
+  size_t mask = d->capacity - 1;
+  size_t i = hashval & mask;
+  while (d->slots[i].name != NULL) {
+    if (d->slots[i].hash == hashval && strcmp(name, d->slots[i].name) == 0) {
+      break;
     }
+    i = (i + 1) & mask;
   }
-  // puts("not\n");
-  return NULL;
+  return i;
+}
+
+static slot* _get(dictionary* d, char *name)
+{
+  slot* s = &d->slots[_find(d, name, hash(name))];
+  return s->name != NULL ? s : NULL;
+}
+
+static bool
+_resize(dictionary* d, size_t capacity)
+{
+  slot* slots = calloc(capacity, sizeof(slot));
+  if (slots == NULL) {
+    return false;
+  }
+  slot* old = d->slots;
+  size_t old_capacity = d->capacity;
+  d->slots = slots;
+  d->capacity = capacity;
+  for(size_t i=0; i < old_capacity; i++) {
+    if (old[i].name != NULL) {
+      d->slots[_find(d, old[i].name, old[i].hash)] = old[i];
+    }
+  }
+  free(old);
+  return true;
 }
 
 void* dictionary_get(dictionary* d, char* name)
 {
-  entry* entry = _get(d, name);
-  
-  if (entry) {
-    return entry->value;
+  slot* s = _get(d, name);
+
+  if (s) {
+    return s->value;
   }
 
   return NULL;
@@ -67,136 +112,133 @@ void* dictionary_get(dictionary* d, char* name)
 
 bool dictionary_has(dictionary* d, char *name)
 {
-  entry* entry = _get(d, name);
-
-  if (entry) {
-    return true;
-  }
-
-  return false;
+  return _get(d, name) != NULL;
 }
 
 void
 dictionary_put(dictionary* d, char* name, void* value)
 {
-    // printf("put %p %s\n", d, name);
-    entry* element;
-    unsigned int hashval;
-
-    element = _get(d, name);
-
-    if (element == NULL) {
-        element = (entry*) malloc(sizeof(*element));
-        if (element == NULL || (element->name = C_STRDUP(name)) == NULL) {
+    uint32_t hashval = hash(name);
+    slot* s = &d->slots[_find(d, name, hashval)];
+
+    if (s->name == NULL) {
+        if ((d->count + 1) * 4 > d->capacity * 3) {
+          if (!_resize(d, d->capacity * 2)) {
+            return;
+          }
+          s = &d->slots[_find(d, name, hashval)];
+        }
+        s->name = d->names ? arena_strndup(d->names, name, strlen(name)) : C_STRDUP(name);
+        if (s->name == NULL) {
           return;
         }
-        hashval = hash(name);
-        element->next = d->hashtab[hashval];
-        d->hashtab[hashval] = element;
+        s->hash = hashval;
+        d->count++;
     }
-    // printf("entry %p\n", element);
-    element->value = value;
+    s->value = value;
 }
 
 void*
 dictionary_del(dictionary* d, char* name)
 {
-  entry* root = d->hashtab[hash(name)];
-
-	if(root==NULL){
-		return NULL;
-	}
-
-	if(strcmp(name, root->name)==0){
-		d->hashtab[hash(name)] = root->next; 
-	    void *value = root->value;
-    	free(root->name);
-    	free(root);
-    	return value;
-	}
-
-	entry* element = root;
-	while(element->next){
-		entry *next = element->next;
-		if(strcmp(name, next->name) == 0){
-			element->next = next->next;
-	    	void *value = next->value;
-    		free(next->name);
-    		free(next); 
-    		return value;
-		}
-	}
+  size_t mask = d->capacity - 1;
+  size_t i = _find(d, name, hash(name));
+  if (d->slots[i].name == NULL) {
+    return NULL;
+  }
 
-  return NULL;
+  void* value = d->slots[i].value;
+  if (d->names == NULL) {
+    free(d->slots[i].name);
+  }
+  d->count--;
+
+  // Move back the entries that would no longer be found across the hole
+  size_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (d->slots[j].name == NULL) {
+      break;
+    }
+    size_t home = d->slots[j].hash & mask;
+    bool reachable = i <= j ? ( i < home && home <= j ) : ( i < home || home <= j );
+    if (!reachable) {
+      d->slots[i] = d->slots[j];
+      i = j;
+    }
+  }
+  d->slots[i].name = NULL;
+
+  return value;
 }
 
 void
 dictionary_each(dictionary* d, dictionary_each_cb cb, void* context)
 {
-  entry* next_entry = NULL;
-  
   if (!cb) {
     return;
   }
 
-  for(size_t i=0; i < HASHSIZE; i++) {
-    entry* entry = d->hashtab[i];
-    while(entry) {
-      next_entry = entry->next;
-      cb(entry->name, entry->value, context);
-      entry = next_entry;
+  for(size_t i=0; i < d->capacity; i++) {
+    slot* s = &d->slots[i];
+    if (s->name != NULL) {
+      cb(s->name, s->value, context);
     }
   }
 }
 
 dictionary*
-dictionary_new()
+dictionary_new_in(arena* names)
 {
-  // printf("dictionary size: %ld\n", sizeof(dictionary));
   dictionary* d = malloc(sizeof(dictionary));
   if (d == NULL) {
     return NULL;
   }
-  for(size_t i=0; i < HASHSIZE; i++) {
-    d->hashtab[i] = NULL;
+  d->slots = calloc(INITIAL_CAPACITY, sizeof(slot));
+  if (d->slots == NULL) {
+    free(d);
+    return NULL;
   }
+  d->capacity = INITIAL_CAPACITY;
+  d->count = 0;
+  d->names = names;
   return d;
 }
 
-typedef struct {
- dictionary* d;
- dictionary_each_cb cb;
-} _free_s;
-
-static void
-destroy_cb_pass_1(char* name, void* value, void* context)
+dictionary*
+dictionary_new()
 {
-	_free_s *ctx = (_free_s*) context;
-	// dictionary *d = ctx->d;
-	dictionary_each_cb free_cb = ctx->cb;
-        free_cb(name, value, NULL); 
-       	// dictionary_del(d, name);
+  return dictionary_new_in(NULL);
 }
 
-static void
-destroy_cb_pass_2(char* name, void* value, void* context)
+  static void
+_release_entries(dictionary* d, dictionary_each_cb free_cb)
 {
-	_free_s *ctx = (_free_s*) context;
-	dictionary *d = ctx->d;
-	// dictionary_each_cb free_cb = ctx->cb;
-        // free_cb(name, value, NULL); 
-       	dictionary_del(d, name);
+  for(size_t i=0; i < d->capacity; i++) {
+    slot* s = &d->slots[i];
+    if (s->name != NULL) {
+      if (free_cb) {
+        free_cb(s->name, s->value, NULL);
+      }
+      if (d->names == NULL) {
+        free(s->name);
+      }
+    }
+  }
 }
 
+void
+dictionary_clear(dictionary* d, dictionary_each_cb free_cb)
+{
+  _release_entries(d, free_cb);
+  memset(d->slots, 0, d->capacity * sizeof(slot));
+  d->count = 0;
+}
 
 void
 dictionary_destroy(dictionary* d, dictionary_each_cb free_cb)
 {
-  _free_s ctx = {
-	.d = d,
-        .cb = free_cb
-  };
-  dictionary_each(d, destroy_cb_pass_1, &ctx);
-  dictionary_each(d, destroy_cb_pass_2, &ctx);
+  _release_entries(d, free_cb);
+  free(d->slots);
   free(d);
 }
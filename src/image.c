@@ -0,0 +1,391 @@
+// -- Binary program images
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arch.h"
+#include "image.h"
+#include "lines.h"
+#include "tokenizer.h"
+
+#ifdef LINES_GROWABLE
+
+/*
+  A program image holds program memory as lines_pack() leaves it, so
+  loading a crunched one is mapping the file and handing its lines to
+  lines_adopt().
+
+    header    image_header
+    names     interned variable names, NUL terminated, in index order
+    body      the packed lines, followed by an empty sentinel line
+
+  A crunched body refers to keywords and variables by their index. The
+  header holds a signature of the keyword table, such an image only loads
+  with the same keywords. The names are interned again in order after the
+  old ones are cleared, so they get back the same index. An expanded body
+  holds plain text lines and has no names, its lines are crunched again on
+  loading, like LOAD does.
+
+  Line numbers and lengths are stored as they are in memory, the header
+  records the byte order and the size of a line header to refuse images
+  from a different build, a crunched body also has to agree on numbers
+  being floats or doubles. The checksum covers names and body.
+*/
+
+#define IMAGE_MAGIC "BIMG"
+#define IMAGE_VERSION 1
+#define IMAGE_ORDER 0x0102
+
+#define image_flag_crunched 0x01
+#define image_flag_double 0x02
+
+#ifdef BASIC_NUMBER_DOUBLE
+#  define image_number_flag image_flag_double
+#else
+#  define image_number_flag 0
+#endif
+
+#define CHECKSUM_INIT 2166136261UL
+
+typedef struct
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t order;
+  uint16_t flags;
+  uint16_t line_header;
+  uint32_t keywords;
+  uint32_t names_size;
+  uint32_t body_size;
+  uint32_t checksum;
+} image_header;
+
+// The mapped image while its lines are program memory
+static char* __image = NULL;
+static size_t __image_size = 0;
+
+  static uint32_t
+_checksum(uint32_t hash, char* data, size_t size)
+{
+  // FNV-1a
+  for(size_t i=0; i<size; i++)
+  {
+    hash ^= (unsigned char) data[i];
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+  static uint32_t
+_keywords_signature(void)
+{
+  uint32_t hash = CHECKSUM_INIT;
+  char* name;
+  for(size_t i=0; (name = tokenizer_crunched_keyword(i)) != NULL; i++)
+  {
+    hash = _checksum(hash, name, strlen(name) + 1);
+  }
+  return hash;
+}
+
+  static void
+_release(void)
+{
+  arch_unmap_image(__image, __image_size);
+  __image = NULL;
+  __image_size = 0;
+}
+
+/*
+  Build an expanded body: every line as plain text, with its line header.
+*/
+  static char*
+_expanded_body(size_t* body_size)
+{
+  size_t header = offsetof(line, contents);
+  size_t capacity = 1024;
+  size_t size = 0;
+  char* body = malloc(capacity);
+
+  lines_cursor cursor;
+  for(bool more = lines_cursor_first(&cursor); more && body; more = lines_cursor_next(&cursor))
+  {
+    for(;;)
+    {
+      line* l = (line*) (body + size);
+      size_t room = capacity - size;
+      if ( room > header + 1
+        && tokenizer_expand(cursor.contents, &(l->contents), room - header) )
+      {
+        size_t length = strlen(&(l->contents)) + 1;
+        if ( length > lines_max_length )
+        {
+          free(body);
+          return NULL;
+        }
+        l->number = cursor.number;
+        l->length = length;
+        size += header + length;
+        break;
+      }
+      capacity *= 2;
+      char* grown = realloc(body, capacity);
+      if ( grown == NULL )
+      {
+        free(body);
+        return NULL;
+      }
+      body = grown;
+    }
+  }
+
+  *body_size = size;
+  return body;
+}
+
+  image_status
+image_save(char* filename, bool crunched)
+{
+  static line sentinel;
+
+  image_header header;
+  memset(&header, 0x00, sizeof(header));
+  memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+  header.version = IMAGE_VERSION;
+  header.order = IMAGE_ORDER;
+  header.line_header = offsetof(line, contents);
+  header.flags = image_number_flag;
+
+  char* names = NULL;
+  size_t names_size = 0;
+  char* body;
+  size_t body_size;
+  char* expanded = NULL;
+
+  if ( crunched )
+  {
+    header.flags |= image_flag_crunched;
+    header.keywords = _keywords_signature();
+
+    char* name;
+    for(size_t i=0; (name = tokenizer_variable_name(i)) != NULL; i++)
+    {
+      names_size += strlen(name) + 1;
+    }
+    names = malloc(names_size + 1);
+    if ( names == NULL )
+    {
+      return image_out_of_memory;
+    }
+    char* p = names;
+    for(size_t i=0; (name = tokenizer_variable_name(i)) != NULL; i++)
+    {
+      size_t size = strlen(name) + 1;
+      memcpy(p, name, size);
+      p += size;
+    }
+
+    body_size = lines_pack(&body);
+  }
+  else
+  {
+    expanded = _expanded_body(&body_size);
+    if ( expanded == NULL )
+    {
+      return image_out_of_memory;
+    }
+    body = expanded;
+  }
+
+  header.names_size = names_size;
+  header.body_size = body_size + offsetof(line, contents);
+  header.checksum = _checksum(CHECKSUM_INIT, names, names_size);
+  header.checksum = _checksum(header.checksum, body, body_size);
+  header.checksum = _checksum(header.checksum, (char*) &sentinel, offsetof(line, contents));
+
+  arch_image_part parts[] = {
+    { &header, sizeof(header) },
+    { names, names_size },
+    { body, body_size },
+    { &sentinel, offsetof(line, contents) }
+  };
+  int rv = arch_save_image(filename, parts, sizeof(parts) / sizeof(parts[0]));
+
+  free(names);
+  free(expanded);
+
+  return rv == 0 ? image_ok : image_io_error;
+}
+
+  static image_status
+_check(char* image, size_t size, image_header* header)
+{
+  if ( size < sizeof(image_header) )
+  {
+    return image_invalid;
+  }
+  memcpy(header, image, sizeof(image_header));
+
+  if ( memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0
+    || sizeof(image_header) + (size_t) header->names_size + header->body_size != size )
+  {
+    return image_invalid;
+  }
+
+  if ( header->version != IMAGE_VERSION
+    || header->order != IMAGE_ORDER
+    || header->line_header != offsetof(line, contents)
+    || ( ( header->flags & image_flag_crunched )
+      && ( header->keywords != _keywords_signature()
+        || ( header->flags & image_flag_double ) != image_number_flag ) ) )
+  {
+    return image_incompatible;
+  }
+
+  char* names = image + sizeof(image_header);
+  if ( _checksum(CHECKSUM_INIT, names, size - sizeof(image_header)) != header->checksum
+    || ( header->names_size > 0 && names[header->names_size - 1] != '\0' ) )
+  {
+    return image_invalid;
+  }
+
+  return image_ok;
+}
+
+  static image_status
+_adopt(char* image, image_header* header)
+{
+  // Intern the names again, they get back their index
+  char* names = image + sizeof(image_header);
+  lines_clear();
+  tokenizer_clear_variables();
+  size_t index = 0;
+  for(char* name = names; name < names + header->names_size; name += strlen(name) + 1)
+  {
+    if ( tokenizer_intern_variable(name) != index++ )
+    {
+      return image_invalid;
+    }
+  }
+
+  if ( ! lines_adopt(names + header->names_size, header->body_size, _release) )
+  {
+    return image_invalid;
+  }
+  return image_ok;
+}
+
+/*
+  Crunch the plain text lines of an expanded body into program memory.
+*/
+  static image_status
+_load_expanded(char* image, image_header* header)
+{
+  lines_clear();
+  tokenizer_clear_variables();
+
+  size_t line_header = offsetof(line, contents);
+  char* body = image + sizeof(image_header) + header->names_size;
+  size_t end = header->body_size - line_header;
+  line* sentinel = (line*) (body + end);
+  if ( header->body_size < line_header || sentinel->number != 0 || sentinel->length != 0 )
+  {
+    return image_invalid;
+  }
+
+  size_t count = 0;
+  for(size_t offset = 0; offset < end; offset += line_header + ((line*) (body + offset))->length)
+  {
+    line* l = (line*) (body + offset);
+    if ( offset + line_header > end
+      || l->length == 0
+      || offset + line_header + l->length > end
+      || (&(l->contents))[l->length - 1] != '\0' )
+    {
+      return image_invalid;
+    }
+    count++;
+  }
+
+  lines_entry* entries = malloc(( count ? count : 1 ) * sizeof(lines_entry));
+  if ( entries == NULL )
+  {
+    return image_out_of_memory;
+  }
+
+  image_status status = image_ok;
+  size_t crunched = 0;
+  for(size_t offset = 0; crunched < count && status == image_ok; crunched++)
+  {
+    line* l = (line*) (body + offset);
+    offset += line_header + l->length;
+    // A crunched token takes at most 7 bytes for every character of text
+    size_t size = 7 * (size_t) l->length + 1;
+    if ( size > lines_max_length )
+    {
+      size = lines_max_length;
+    }
+    char* contents = malloc(size);
+    if ( contents == NULL )
+    {
+      status = image_out_of_memory;
+      break;
+    }
+    entries[crunched].number = l->number;
+    entries[crunched].contents = contents;
+    if ( ! tokenizer_crunch(&(l->contents), contents, size) )
+    {
+      status = image_invalid;
+    }
+  }
+
+  if ( status == image_ok && ! lines_load(entries, count) )
+  {
+    status = image_out_of_memory;
+  }
+
+  for(size_t i=0; i<crunched; i++)
+  {
+    free(entries[i].contents);
+  }
+  free(entries);
+  return status;
+}
+
+  image_status
+image_load(char* filename)
+{
+  size_t size;
+  char* image = arch_map_image(filename, &size);
+  if ( image == NULL )
+  {
+    return image_io_error;
+  }
+
+  image_header header;
+  image_status status = _check(image, size, &header);
+  if ( status == image_ok && ! ( header.flags & image_flag_crunched ) )
+  {
+    // The lines are copied into program memory, the image can go
+    status = _load_expanded(image, &header);
+    arch_unmap_image(image, size);
+    return status;
+  }
+  if ( status == image_ok )
+  {
+    status = _adopt(image, &header);
+  }
+  if ( status != image_ok )
+  {
+    arch_unmap_image(image, size);
+    return status;
+  }
+
+  __image = image;
+  __image_size = size;
+  return image_ok;
+}
+
+#endif
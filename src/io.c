@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdio.h>
 
 #include <io.h>
 
@@ -16,13 +17,23 @@ basic_io_print(char* buffer)
     }
 }  
 
+  void
+basic_io_write(char* buffer, size_t length)
+{
+    for(size_t i=0; i<length; ++i)
+    {
+      __putch(buffer[i]);
+    }
+}  
+
 char*
 basic_io_readline(char* prompt, char* buffer, size_t buffer_size)
 {
   size_t len = 0;
-  char ch;
+  int ch;
   basic_io_print(prompt);
-  while ((ch = __getch()) != '\n' && len < buffer_size - 1)
+  // Check for room first, so a full buffer leaves the rest of the line unread
+  while (len < buffer_size - 1 && (ch = __getch()) != '\n' && ch != EOF)
   {
 #   if ARCH==ARCH_XMEGA
     ch = toupper(ch);
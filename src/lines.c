@@ -8,198 +8,449 @@
 //  v integrate with parser
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdio.h>
 
 #include "hexdump.h"
 #include "lines.h"
 
+/*
+  Lines are packed in line number order in a gap buffer: the lines before
+  the edit point sit at the start of memory, the lines after it at the end,
+  followed by an empty sentinel line. Storing or deleting a line moves the
+  gap to the edit point first, so a run of edits close to each other only
+  moves the lines in between. Appending, as when typing or running a
+  program in order, moves nothing at all.
+
+  Growable program memory is one block, so lines stay contiguous for the
+  gap buffer and the index. When the gap can't hold a new line, the block
+  is reallocated at twice its size, rounded up to a whole chunk, and the
+  lines after the gap move to its new end. NEW shrinks it back.
+
+  Program memory can also be adopted from elsewhere, like a program image
+  mapped from a file. Adopted memory is edited in place, and is swapped for
+  memory of our own once it has to grow.
+
+  A sorted index holds the line numbers with the offset of their line in
+  memory. Lines are found with a binary search on it instead of a walk over
+  the packed list.
+*/
+
+typedef struct
+{
+  uint16_t number;
+  size_t offset;
+} line_index;
+
 static char* __memory;
-static char* __memory_end;
 static size_t __memory_size;
 
+#ifdef LINES_GROWABLE
+#define LINES_CHUNK_SIZE 1024
+
+static bool __growable = false;
+static size_t __initial_size;
+static size_t __limit = 0;
+static lines_release_cb __release = NULL;
+
+  static void
+_release_memory(void)
+{
+  if ( __release != NULL )
+  {
+    __release();
+    __release = NULL;
+  }
+  else
+  {
+    free(__memory);
+  }
+}
+#endif
+static uint32_t __generation = 0;
+
+// The gap, and the index position of the first line after it
+static size_t __gap_start;
+static size_t __gap_end;
+static size_t __gap_position;
+
+static line_index* __index = NULL;
+static size_t __index_count = 0;
+static size_t __index_capacity = 0;
+
+  static size_t
+_line_size(size_t length)
+{
+  return offsetof(line, contents) + length;
+}
+
   static line*
-_next(line* l)
+_line_at(size_t position)
 {
-  char* p = (char*) l;
-  p += sizeof(line) - 1 + l->length;
-  return (line*) p;
+  return (line*) (__memory + __index[position].offset);
 }
 
+  static size_t
+_sentinel_offset(void)
+{
+  return __memory_size - _line_size(0);
+}
+
+/*
+  Binary search for a line number. Returns true when found, position is
+  then its place in the index. Otherwise position is where it would go.
+*/
   static bool
-_is_end(line* l)
+_find(uint16_t number, size_t* position)
 {
-  return l && l->number == 0 && l->length == 0;
+  size_t low = 0;
+  size_t high = __index_count;
+  while ( low < high )
+  {
+    size_t mid = low + (high - low) / 2;
+    if ( __index[mid].number < number )
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  *position = low;
+  return low < __index_count && __index[low].number == number;
 }
 
-  static line*
-_find_end(line* l)
+  static bool
+_index_reserve(size_t count)
 {
-  line* n = l;
-  while ( ! _is_end( n ) )
+  if ( count <= __index_capacity )
+  {
+    return true;
+  }
+  size_t capacity = __index_capacity ? __index_capacity : 64;
+  while ( capacity < count )
+  {
+    capacity *= 2;
+  }
+  line_index* index = realloc(__index, capacity * sizeof(line_index));
+  if ( index == NULL )
+  {
+    return false;
+  }
+  __index = index;
+  __index_capacity = capacity;
+  return true;
+}
+
+/*
+  Move the gap in front of the line at position (or to the end when
+  position is the line count).
+*/
+  static void
+_move_gap(size_t position)
+{
+  size_t gap_size = __gap_end - __gap_start;
+
+  if ( position < __gap_position )
+  {
+    // Lines [position, gap position) go behind the gap
+    size_t from = __index[position].offset;
+    size_t size = __gap_start - from;
+    memmove(__memory + __gap_end - size, __memory + from, size);
+    for(size_t i=position; i<__gap_position; i++)
+    {
+      __index[i].offset += gap_size;
+    }
+    __gap_start -= size;
+    __gap_end -= size;
+  }
+  else if ( position > __gap_position )
+  {
+    // Lines [gap position, position) go in front of the gap
+    size_t to = position < __index_count ? __index[position].offset : _sentinel_offset();
+    size_t size = to - __gap_end;
+    memmove(__memory + __gap_start, __memory + __gap_end, size);
+    for(size_t i=__gap_position; i<position; i++)
+    {
+      __index[i].offset -= gap_size;
+    }
+    __gap_start += size;
+    __gap_end += size;
+  }
+
+  __gap_position = position;
+}
+
+/*
+  Make sure the gap holds at least size bytes, growing program memory when
+  it is growable.
+*/
+  static bool
+_reserve(size_t size)
+{
+  size_t gap_size = __gap_end - __gap_start;
+  if ( size <= gap_size )
+  {
+    return true;
+  }
+#ifdef LINES_GROWABLE
+  if ( ! __growable )
+  {
+    return false;
+  }
+
+  size_t needed = __memory_size + size - gap_size;
+  size_t new_size = __memory_size * 2;
+  if ( new_size < needed )
+  {
+    new_size = needed;
+  }
+  new_size = ( new_size + LINES_CHUNK_SIZE - 1 ) / LINES_CHUNK_SIZE * LINES_CHUNK_SIZE;
+  if ( __limit != 0 && new_size > __limit )
+  {
+    new_size = __limit;
+  }
+  if ( new_size < needed )
+  {
+    return false;
+  }
+
+  char* memory;
+  if ( __release != NULL )
+  {
+    // Adopted memory can't be reallocated
+    memory = malloc(new_size);
+    if ( memory == NULL )
+    {
+      return false;
+    }
+    memcpy(memory, __memory, __memory_size);
+    _release_memory();
+  }
+  else
+  {
+    memory = realloc(__memory, new_size);
+    if ( memory == NULL )
+    {
+      return false;
+    }
+  }
+
+  // The lines after the gap and the sentinel move to the end
+  size_t grow = new_size - __memory_size;
+  size_t tail = __memory_size - __gap_end;
+  memmove(memory + __gap_end + grow, memory + __gap_end, tail);
+  memset(memory + __gap_end, 0x00, grow);
+  for(size_t i=__gap_position; i<__index_count; i++)
   {
-    n = _next( n );
+    __index[i].offset += grow;
   }
-  return n;  
+  __gap_end += grow;
+  __memory = memory;
+  __memory_size = new_size;
+  // Lines moved, pointers into them are stale
+  __generation++;
+  return true;
+#else
+  return false;
+#endif
+}
+
+  static void
+_write_line(line* l, uint16_t number, char* contents, size_t length)
+{
+  l->number = number;
+  l->length = length;
+  memcpy(&(l->contents), contents, length);
 }
 
   void
 lines_init(char *memory, size_t memory_size)
 {
+#ifdef LINES_GROWABLE
+  if ( __growable )
+  {
+    _release_memory();
+    __growable = false;
+  }
+#endif
   __memory = memory;
-  __memory_end = memory;
   __memory_size = memory_size;
- 
-  // Signal end 
-  line* l = (line*) __memory;
-  l->number = 0;
-  l->length = 0;
+  lines_clear();
+}
+
+#ifdef LINES_GROWABLE
+  bool
+lines_init_growable(size_t memory_size)
+{
+  if ( memory_size < _line_size(0) )
+  {
+    memory_size = _line_size(0);
+  }
+  char* memory = malloc(memory_size);
+  if ( memory == NULL )
+  {
+    return false;
+  }
+  lines_init(memory, memory_size);
+  __growable = true;
+  __initial_size = memory_size;
+  return true;
+}
+
+  void
+lines_set_limit(size_t limit)
+{
+  __limit = limit;
+}
+
+  size_t
+lines_pack(char** memory)
+{
+  _move_gap(__index_count);
+  __generation++;
+  *memory = __memory;
+  return __gap_start;
+}
+
+  bool
+lines_adopt(char* memory, size_t memory_size, lines_release_cb release)
+{
+  lines_clear();
+
+  size_t header = _line_size(0);
+  if ( memory_size < header )
+  {
+    return false;
+  }
+  size_t end = memory_size - header;
+  line* sentinel = (line*) (memory + end);
+  if ( sentinel->number != 0 || sentinel->length != 0 )
+  {
+    return false;
+  }
+
+  // Check the lines and index them in one walk
+  size_t count = 0;
+  size_t offset = 0;
+  uint16_t previous = 0;
+  while ( offset < end )
+  {
+    line* l = (line*) (memory + offset);
+    if ( offset + header > end
+      || l->number <= previous
+      || l->length == 0
+      || offset + _line_size(l->length) > end
+      || (&(l->contents))[l->length - 1] != '\0'
+      || ! _index_reserve(count + 1) )
+    {
+      return false;
+    }
+    __index[count].number = l->number;
+    __index[count].offset = offset;
+    count++;
+    previous = l->number;
+    offset += _line_size(l->length);
+  }
+
+  if ( __growable )
+  {
+    _release_memory();
+  }
+  else
+  {
+    __initial_size = LINES_CHUNK_SIZE;
+  }
+  __memory = memory;
+  __memory_size = memory_size;
+  __release = release;
+  __growable = true;
+
+  __index_count = count;
+  __gap_start = end;
+  __gap_end = end;
+  __gap_position = count;
+  __generation++;
+  return true;
+}
+#endif
+
+  void
+lines_destroy(void)
+{
+#ifdef LINES_GROWABLE
+  if ( __growable )
+  {
+    _release_memory();
+    __memory = NULL;
+    __memory_size = 0;
+    __growable = false;
+  }
+#endif
+  free(__index);
+  __index = NULL;
+  __index_count = 0;
+  __index_capacity = 0;
 }
 
   size_t
 lines_memory_used(void)
 {
-  char *p = __memory;
-  line* start = (line*) p;
-  line* end = _find_end(start);
-  end = _next(end);
-      
-  char* m_start = (char*) start;
-  char* m_end = (char*) end;
-   
-   return m_end - m_start;
+  return __memory_size - (__gap_end - __gap_start);
 }
 
   size_t
 lines_memory_available(void)
 {
-  return __memory_size - lines_memory_used();
+  return __gap_end - __gap_start;
 }
 
   bool
 lines_store(uint16_t number, char* contents)
 {
-  // support insert
-
-
-  char *p = __memory;
-  line* l = (line*) p;
-  while ( ! _is_end( l ) )
+  size_t length = strlen(contents) + 1;
+  if ( length > lines_max_length )
   {
-    line* next = _next( l );
+    return false;
+  }
 
-    // Find line that is to be insert after. That line has a line number < insert and the next line has a >
-    if ( l->number < number && next->number > number )
-    {
-      // We need to insert
-      // printf("insert %d\n", number);
-      
-      // The address of the insert is the same as the next line
-      line* insert = next;
-     
-      // But we need to move the memory block holding the rest to the right.
-      line* end = _find_end( insert );
-      end = _next(end); // Move to next empty slot (we keep the sentinel in the copy)
-      
-      // We have the end*,  calculate size to move
-      char* m_src = (char*) insert;
-      char* m_end = (char*) end;
-      size_t m_size = m_end - m_src;
-
-      // Calculate offset to move 
-      size_t insert_size = sizeof(line) - 1 + strlen(contents) + 1;
-      char* m_dst = m_src + insert_size;
-      
-      // Move the memory block
-      memmove( m_dst, m_src, m_size );
-
-      // Set the data of the insert
-      insert->number = number;
-      insert->length = strlen(contents) + 1;
-      strcpy( &(insert->contents), contents );
-
-      // hexdump( "insert", __memory, 256 );
-      
-      return true;
-    }
-    // Replace
-    if ( l->number == number )
+  size_t position;
+  if ( _find(number, &position) )
+  {
+    // Replace, the line is the last one in front of the gap and can grow
+    // or shrink into it
+    size_t actual = _line_at(position)->length;
+    if ( length > actual && ! _reserve(length - actual) )
     {
-      // printf("replace %d\n", number);
-      
-      // We need to shift the memory to the new offset determined by the size of the line to be inserted
-      
-      line* end = _find_end( l );
-      end = _next(end); // Move to next empty slot (we keep the sentinel in the copy)
-      
-      // Calculate size of bloack
-      char* m_src = (char*) next;
-      char* m_end = (char*) end;
-      size_t m_size = m_end - m_src;
-
-      // Calculate offset to move 
-      size_t replace_size = sizeof(line) - 1 + strlen(contents) + 1;
-      size_t actual_size = sizeof(line) - 1 + strlen(&(l->contents)) + 1;
-      int offset = replace_size - actual_size ;
-      char* m_dst = m_src + offset;
-      
-      // Move the memory block
-      memmove( m_dst, m_src, m_size );
-
-      // Set the data of the replace
-      l->length = strlen(contents) + 1;
-      strcpy( &(l->contents), contents );
-
-      // hexdump( "replace", __memory, 256 );
-      
-      return true;
+      return false;
     }
-    // Prepend
-    if ( l->number > number )
+    _move_gap(position + 1);
+    __gap_start = __index[position].offset + _line_size(length);
+    _write_line(_line_at(position), number, contents, length);
+  }
+  else
+  {
+    // Insert, the line goes at the start of the gap
+    size_t size = _line_size(length);
+    if ( ! _reserve(size) || ! _index_reserve(__index_count + 1) )
     {
-      // printf("prepend %d\n", number);
-      
-      // The address of the insert is the same as the actual line
-      line* insert = l;
-     
-      // But we need to move the memory block holding the rest to the right.
-      line* end = _find_end( insert );
-      end = _next(end); // Move to next empty slot (we keep the sentinel in the copy)
-      
-      // We have the end*,  calculate size to move
-      char* m_src = (char*) insert;
-      char* m_end = (char*) end;
-      size_t m_size = m_end - m_src;
-     
-      // Calculate offset to move 
-      size_t insert_size = sizeof(line) - 1 + strlen(contents) + 1;
-      char* m_dst = m_src + insert_size;
-      
-      // Move the memory block
-      memmove( m_dst, m_src, m_size );
-
-      // Set the data of the insert
-      insert->number = number;
-      insert->length = strlen(contents) + 1;
-      strcpy( &(insert->contents), contents );
-
-      // hexdump( "prepend", __memory, 256 );
- 
-      return true; 
+      return false;
     }
-
-    l = next;
+    _move_gap(position);
+    memmove(&__index[position+1], &__index[position], (__index_count - position) * sizeof(line_index));
+    __index_count++;
+    __index[position].number = number;
+    __index[position].offset = __gap_start;
+    _write_line(_line_at(position), number, contents, length);
+    __gap_start += size;
+    __gap_position = position + 1;
   }
-  
-  l->number = number;
-  l->length = strlen(contents) + 1; // Length is offset to next line
-  strcpy( &(l->contents), contents );
- 
-  line* end = _next( l );
-  end->number = 0;
-  end->length = 0;
- 
-  // hexdump( "append", __memory, 256 );
+
+  __generation++;
+
+  // hexdump( "store", __memory, 256 );
 
   return true;
 }
@@ -209,95 +460,335 @@ lines_delete(uint16_t number)
 {
   // printf("delete line %d\n", number);
 
-  // find the line
-  line* l = (line*) __memory;
-  while( ! _is_end( l ) && l->number != number)
+  size_t position;
+  if ( ! _find(number, &position) )
   {
-    l = _next( l );
+    // printf("line %d not found\n", number);
+    return false;
   }
 
-  if ( _is_end( l ) )
+  __generation++;
+
+  // The line becomes part of the gap
+  _move_gap(position + 1);
+  size_t size = _line_size(_line_at(position)->length);
+  __gap_start = __index[position].offset;
+  memset(__memory + __gap_start, 0x00, size);
+  memmove(&__index[position], &__index[position+1], (__index_count - position - 1) * sizeof(line_index));
+  __index_count--;
+  __gap_position = position;
+
+  // hexdump( "delete", __memory, 256 );
+  
+  return true;
+}
+
+  size_t
+lines_delete_range(uint16_t start, uint16_t end)
+{
+  if ( end == 0 )
   {
-    // printf("line %d not found\n", number);
-    return false;
+    end = UINT16_MAX;
   }
 
-  // l is the line to delete
-  // check if this is the last line
-  line* next = _next(l);
-  if ( _is_end( next ) )
+  size_t first;
+  _find(start, &first);
+  size_t last = first;
+  while ( last < __index_count && __index[last].number <= end )
   {
-    // printf("delete last line\n");
-    memset( l, 0x00, sizeof(line) - 1 + strlen(&(l->contents)) + 1 );
-    l->number = 0;
-    l->length = 0;
-    strcpy( &(l->contents), "" );
+    last++;
   }
-  else
+  size_t count = last - first;
+  if ( count == 0 )
   {
-    // printf("delete not last line\n");
-    char* dst = (char*) l;
-    char* src = (char*) next;
- 
-    line* lend = _find_end( next );
-    lend = _next(lend); // Move to next empty slot (we keep the sentinel in the copy)
-    char* end = (char*) lend;
-    size_t size = (char*) end - src;
-    memmove( dst, src, size );
+    return 0;
+  }
+
+  __generation++;
+
+  // The whole range becomes part of the gap at once
+  _move_gap(last);
+  size_t from = __index[first].offset;
+  memset(__memory + from, 0x00, __gap_start - from);
+  __gap_start = from;
+  memmove(&__index[first], &__index[last], (__index_count - last) * sizeof(line_index));
+  __index_count -= count;
+  __gap_position = first;
+
+  return count;
+}
+
+/*
+  Replace the program with a batch of lines in any order. When a number
+  occurs more than once, the last one wins. The lines are sorted and
+  packed in one pass, instead of an insert with a memmove per line.
+*/
 
-    size_t rest = src - dst;
-    memset( end - rest, 0x00, rest );
+  static int
+_compare_entries(const void* a, const void* b)
+{
+  lines_entry* ea = *((lines_entry**) a);
+  lines_entry* eb = *((lines_entry**) b);
+  if ( ea->number != eb->number )
+  {
+    return ea->number < eb->number ? -1 : 1;
   }
+  // Keep the order of the batch for equal numbers
+  return ea < eb ? -1 : ( ea > eb ? 1 : 0 );
+}
 
-  // hexdump( "delete", __memory, 256 );
-  
-  return true;
+/*
+  Sort a batch by line number and drop all but the last of each number.
+  Returns NULL when out of memory, count is then the number left.
+*/
+  static lines_entry**
+_sort_entries(lines_entry* entries, size_t* count)
+{
+  lines_entry** sorted = malloc(( *count ? *count : 1 ) * sizeof(lines_entry*));
+  if ( sorted == NULL )
+  {
+    return NULL;
+  }
+  for(size_t i=0; i<*count; i++)
+  {
+    sorted[i] = &entries[i];
+  }
+  qsort(sorted, *count, sizeof(lines_entry*), _compare_entries);
+
+  size_t unique = 0;
+  for(size_t i=0; i<*count; i++)
+  {
+    if ( i+1 < *count && sorted[i+1]->number == sorted[i]->number )
+    {
+      continue;
+    }
+    sorted[unique++] = sorted[i];
+  }
+  *count = unique;
+  return sorted;
 }
 
-  static bool
-_in_range(uint16_t i, uint16_t low, uint16_t high)
+  bool
+lines_load(lines_entry* entries, size_t count)
 {
-  if(low==0 && high==0)
+  lines_clear();
+
+  lines_entry** sorted = _sort_entries(entries, &count);
+  if ( sorted == NULL || ! _index_reserve(count) )
   {
-    return true;
+    free(sorted);
+    return false;
   }
-  if(low==0 && i<=high)
+
+  bool ok = true;
+  for(size_t i=0; i<count; i++)
   {
-    return true;
+    size_t length = strlen(sorted[i]->contents) + 1;
+    size_t size = _line_size(length);
+    if ( length > lines_max_length || ! _reserve(size) )
+    {
+      ok = false;
+      break;
+    }
+    __index[__index_count].number = sorted[i]->number;
+    __index[__index_count].offset = __gap_start;
+    _write_line(_line_at(__index_count), sorted[i]->number, sorted[i]->contents, length);
+    __index_count++;
+    __gap_start += size;
+    __gap_position = __index_count;
+  }
+
+  free(sorted);
+
+  if ( ! ok )
+  {
+    lines_clear();
   }
-  if(high==0 && i>=low)
+
+  return ok;
+}
+
+/*
+  Merge a batch of lines in any order into the program, a line with empty
+  contents deletes that line. The gap goes to the start of memory, then the
+  merged program is written from the start while the old lines are read
+  from behind the gap, in one pass.
+
+  Writing never overtakes reading as long as the gap holds the largest
+  amount the merged lines run ahead, a first pass works that out together
+  with the size of the new index.
+*/
+
+/*
+  One step of the merge: either the next entry of the batch, taking the
+  place of an old line with the same number, or the next old line to keep.
+  consumed is the size of the old line used up by the step.
+*/
+  static bool
+_merge_next(size_t* old, size_t* i, lines_entry** sorted, size_t count,
+  lines_entry** entry, line** kept, size_t* consumed)
+{
+  *entry = NULL;
+  *kept = NULL;
+  *consumed = 0;
+  if ( *i < count && ( *old >= __index_count || sorted[*i]->number <= __index[*old].number ) )
   {
+    *entry = sorted[(*i)++];
+    if ( *old < __index_count && (*entry)->number == __index[*old].number )
+    {
+      *consumed = _line_size(_line_at((*old)++)->length);
+    }
     return true;
   }
-  if(i>= low && i<=high)
+  if ( *old < __index_count )
   {
+    *kept = _line_at((*old)++);
+    *consumed = _line_size((*kept)->length);
     return true;
   }
   return false;
-} 
+}
+
+  bool
+lines_merge(lines_entry* entries, size_t count)
+{
+  lines_entry** sorted = _sort_entries(entries, &count);
+  if ( sorted == NULL )
+  {
+    return false;
+  }
+
+  _move_gap(0);
+  __generation++;
+
+  size_t lines = 0;
+  size_t written = 0;
+  size_t read = 0;
+  size_t ahead = 0;
+  size_t old = 0;
+  size_t i = 0;
+  lines_entry* entry;
+  line* kept;
+  size_t consumed;
+  while ( _merge_next(&old, &i, sorted, count, &entry, &kept, &consumed) )
+  {
+    read += consumed;
+    if ( kept != NULL )
+    {
+      written += consumed;
+      lines++;
+    }
+    else if ( entry->contents[0] != '\0' )
+    {
+      size_t length = strlen(entry->contents) + 1;
+      if ( length > lines_max_length )
+      {
+        free(sorted);
+        return false;
+      }
+      written += _line_size(length);
+      lines++;
+    }
+    if ( written > read && written - read > ahead )
+    {
+      ahead = written - read;
+    }
+  }
+
+  line_index* index = malloc(( lines ? lines : 1 ) * sizeof(line_index));
+  if ( index == NULL || ! _reserve(ahead) )
+  {
+    free(index);
+    free(sorted);
+    return false;
+  }
+
+  size_t n = 0;
+  size_t out = 0;
+  old = 0;
+  i = 0;
+  while ( _merge_next(&old, &i, sorted, count, &entry, &kept, &consumed) )
+  {
+    line* l = (line*) (__memory + out);
+    if ( kept != NULL )
+    {
+      memmove(l, kept, consumed);
+    }
+    else if ( entry->contents[0] != '\0' )
+    {
+      _write_line(l, entry->number, entry->contents, strlen(entry->contents) + 1);
+    }
+    else
+    {
+      continue;
+    }
+    index[n].number = l->number;
+    index[n].offset = out;
+    n++;
+    out += _line_size(l->length);
+  }
+
+  free(__index);
+  __index = index;
+  __index_count = n;
+  __index_capacity = lines ? lines : 1;
+  __gap_start = out;
+  __gap_end = _sentinel_offset();
+  __gap_position = n;
+
+  free(sorted);
+  return true;
+}
 
   void
 lines_list(uint16_t start, uint16_t end, lines_list_cb out)
 {
-  char *p = __memory;
-  
-  line* l = (line*) p;
-  while( ! _is_end( l ) )
+  size_t position;
+  _find(start, &position);
+  for(; position<__index_count; position++)
   {
-    if(_in_range(l->number, start, end))
+    line* l = _line_at(position);
+    if ( end != 0 && l->number > end )
     {
-      out(l->number, &(l->contents) );
+      break;
     }
-    l = _next( l );
+    out(l->number, &(l->contents) );
   }
 }
 
   void
 lines_clear(void)
 {
-  char* end = (char*) _next( _find_end( (line*) __memory ) );
-  memset( __memory, 0x00, end - __memory );
-  line* l = (line*) __memory;
+  __generation++;
+#ifdef LINES_GROWABLE
+  if ( __growable && __release != NULL )
+  {
+    // Back to memory of our own
+    char* memory = malloc(__initial_size);
+    if ( memory != NULL )
+    {
+      _release_memory();
+      __memory = memory;
+      __memory_size = __initial_size;
+    }
+  }
+  else if ( __growable && __memory_size > __initial_size )
+  {
+    char* memory = realloc(__memory, __initial_size);
+    if ( memory != NULL )
+    {
+      __memory = memory;
+      __memory_size = __initial_size;
+    }
+  }
+#endif
+  memset( __memory, 0x00, __memory_size );
+  __gap_start = 0;
+  __gap_end = _sentinel_offset();
+  __gap_position = 0;
+  __index_count = 0;
+  // Signal end 
+  line* l = (line*) (__memory + _sentinel_offset());
   l->number = 0;
   l->length = 0;
   // hexdump( "clear", __memory, 256 );
@@ -306,40 +797,94 @@ lines_clear(void)
   char*
 lines_get_contents(uint16_t number)
 {
-  line* l = (line*) __memory;
-  while( ! _is_end( l ) && l->number != number)
-  {
-    l = _next( l );
-  }
-
-  if ( _is_end( l ) )
+  size_t position;
+  if ( ! _find(number, &position) )
   {
     return NULL;
   }
 
-  return &(l->contents);
+  return &(_line_at(position)->contents);
 }
 
   uint16_t
 lines_first(void)
 {
-  line* l = (line*) __memory;
-  return l->number;
+  return __index_count > 0 ? __index[0].number : 0;
 }
 
   uint16_t
 lines_next(uint16_t number)
 {
-  line* l = (line*) __memory;
-  while( ! _is_end( l ) && l->number <= number)
+  size_t position;
+  if ( _find(number, &position) )
   {
-    l = _next( l );
+    position++;
   }
 
-  if ( number == l->number )
+  if ( position >= __index_count )
   {
     return 0;
   }
 
-  return l->number;
+  return __index[position].number;
+}
+
+  static bool
+_cursor_set(lines_cursor* cursor, size_t position)
+{
+  cursor->position = position;
+  cursor->generation = __generation;
+  if ( position >= __index_count )
+  {
+    cursor->number = 0;
+    cursor->contents = NULL;
+    return false;
+  }
+  line* l = _line_at(position);
+  cursor->number = l->number;
+  cursor->contents = &(l->contents);
+  return true;
+}
+
+  bool
+lines_cursor_first(lines_cursor* cursor)
+{
+  return _cursor_set(cursor, 0);
+}
+
+  bool
+lines_cursor_next(lines_cursor* cursor)
+{
+  if ( cursor->contents == NULL )
+  {
+    return _cursor_set(cursor, __index_count);
+  }
+
+  size_t position = cursor->position;
+  if ( cursor->generation != __generation )
+  {
+    // The program changed, find the line again (or where it was)
+    if ( ! _find(cursor->number, &position) )
+    {
+      return _cursor_set(cursor, position);
+    }
+  }
+  return _cursor_set(cursor, position + 1);
+}
+
+  bool
+lines_cursor_seek(lines_cursor* cursor, uint16_t number)
+{
+  size_t position;
+  if ( ! _find(number, &position) )
+  {
+    return _cursor_set(cursor, __index_count);
+  }
+  return _cursor_set(cursor, position);
+}
+
+  uint32_t
+lines_generation(void)
+{
+  return __generation;
 }
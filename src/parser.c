@@ -31,13 +31,14 @@ void delay_ms(uint16_t count) {
 #include "variables.h"
 #include "lines.h"
 #include "array.h"
+#include "arena.h"
+#include "image.h"
 #include "kbhit.h"
 #include "io.h"
 #include "parser.h"
 
 #include "usingwin.h"
 
-char *_dummy = 0;
 
 /*
   line = [number] statement [ : statement ] CR
@@ -120,7 +121,7 @@ char *_dummy = 0;
 
 */
 
-#define MAX_LINE tokenizer_string_length
+#define MAX_EXPANDED 256
 
 typedef union
 {
@@ -176,6 +177,11 @@ static token t_keyword_load;
 static token t_keyword_save;
 static token t_keyword_delete;
 static token t_keyword_dir;
+static token t_keyword_merge;
+#ifdef LINES_GROWABLE
+static token t_keyword_bsave;
+static token t_keyword_bload;
+#endif
 // static token t_keyword_def;
 // static token t_keyword_fn;
 
@@ -183,7 +189,7 @@ static token t_op_or;
 static token t_op_and;
 
 uint16_t __line;
-static char* __cursor;
+static lines_cursor __program;
 static char* __memory;
 static char* __stack;
 static size_t __memory_size;
@@ -191,6 +197,11 @@ static size_t __stack_size;
 static size_t __program_size;
 static size_t __stack_p;
 
+// Scratch memory for the statement being executed (variable names, input
+// lines, ...), released when the statement is done.
+static arena* __scratch;
+#define SCRATCH_CHUNK_SIZE 256
+
 basic_putchar __putch = putchar;
 basic_getchar __getch = getchar;
 
@@ -208,18 +219,46 @@ typedef enum
 
 typedef struct
 {
-  uint16_t line;
-  char* cursor;
-  char* char_pointer;
+  lines_cursor line;
+  tokenizer_state tokenizer;
   data_state state : 2;
 } data_pointer;
 
 static data_pointer __data;
 
+typedef struct
+{
+  basic_number number;
+  slice string;
+} data_value;
+
+// A string value is either a view on the program line or a variable,
+// or a malloc'd buffer owned by whoever holds the value.
+typedef struct
+{
+  slice slice;
+  bool mallocd;
+} string_value;
+
+/*
+  A number in an expression. It stays an exact integer while it comes
+  from integer variables, integral literals and integer operations that
+  don't overflow, anything else turns it into a float.
+*/
+typedef struct
+{
+  bool is_integer;
+  union
+  {
+    basic_number number;
+    int32_t integer;
+  } value;
+} numeric_value;
+
 typedef union
 {
-  float numeric;
-  char *string;
+  numeric_value numeric;
+  string_value string;
 } expression_value;
 
 typedef enum
@@ -240,28 +279,57 @@ typedef enum
   stack_frame_type_gosub
 } stack_frame_type;
 
+/*
+  A place to come back to, in a stored line as its number and an offset
+  into the line, so it survives edits that move the lines. A typed line
+  doesn't move while it runs, there the pointer is kept.
+*/
+typedef struct
+{
+  uint16_t line;
+  size_t offset;
+  char* typed;
+} line_position;
+
+/*
+  A FOR frame holds the storage of its loop variable and where the body
+  starts, both as the program cursor and as the position in the token
+  stream. NEXT goes back there without a lookup or lexing, as long as the
+  program didn't change, else it finds the line again by its number.
+  The name is only kept for error messages. An integer loop variable
+  counts with integer end value and step.
+*/
 typedef struct
 {
   stack_frame_type type;
-  char variable_name[tokenizer_variable_length]; 
-  float end_value;
-  float step;
-  size_t line;
-  char* cursor; 
+  size_t size;
+  union
+  {
+    basic_number* number;
+    int32_t* integer;
+  } value;
+  numeric_value end_value;
+  numeric_value step;
+  lines_cursor program;
+  tokenizer_position position;
+  line_position body;
+  char variable_name[]; // stored on the stack, right after the frame
 } stack_frame_for;
 
+#define STACK_ALIGN(size) (((size) + sizeof(char*) - 1) & ~(sizeof(char*) - 1))
+
 typedef struct
 {
   stack_frame_type type;
-  size_t line;
-  char* cursor;
+  line_position position;
 } stack_frame_gosub;
 
 static int basic_dispatch_function(basic_function* function, basic_type* rv);
 static basic_function* find_basic_function_by_type(token sym, basic_function_type type);
 
 static size_t get_vector(size_t* vector, size_t size);
-static char* string_term(void);
+static bool string_term(string_value* string);
+static void string_free(string_value* string);
 int str_len(basic_type* str, basic_type* rv);
 int str_asc(basic_type* str, basic_type* rv);
 int str_val(basic_type* str, basic_type* rv);
@@ -279,35 +347,274 @@ typedef enum {
   OP_NE
 } relop;
 
-static bool string_condition(char *left, char *right, relop op);
-static bool numeric_condition(float left, float right, relop op);
+static bool string_condition(slice left, slice right, relop op);
+static bool numeric_condition(numeric_value left, numeric_value right, relop op);
 static relop get_relop(void);
 
+tokenizer_state __tokenizer;
 token sym;
 void
 get_sym(void)
 {
-  sym = tokenizer_get_next_token();
+  sym = tokenizer_get_next_token(&__tokenizer);
   // printf("sym: %d\n", sym);
 }
 
+/*
+  Copy the current variable name into the scratch arena. There is room
+  for one extra character, so callers can append the '(' of an array name.
+*/
+  static char*
+get_variable_name(void)
+{
+  slice name = tokenizer_get_variable_name(&__tokenizer);
+  char* copy = arena_alloc(__scratch, name.length + 2);
+  memcpy(copy, name.string, name.length);
+  copy[name.length] = '\0';
+  return copy;
+}
+
+/*
+  A variable as the tokenizer hands it out, the slot of its interned name
+  and the name for a lookup when it has none. Integer, byte and bit
+  variables are read and stored as integers.
+*/
+typedef struct
+{
+  size_t slot;
+  slice name;
+  bool integer;
+} variable_ref;
+
+  static variable_ref
+get_variable_ref(void)
+{
+  variable_ref ref;
+  size_t index = tokenizer_get_variable_index(&__tokenizer);
+  ref.slot = ( index == TOKENIZER_NOT_INTERNED ) ? VARIABLE_NO_SLOT : index;
+  ref.name = tokenizer_get_variable_name(&__tokenizer);
+  variable_type type = variable_name_type(ref.name);
+  ref.integer = type != variable_type_numeric && type != variable_type_string;
+  return ref;
+}
+
+  static variable*
+bind_variable(variable_ref* ref, bool is_array)
+{
+  return variable_bind(ref->slot, ref->name, is_array);
+}
+
+/*
+  Interned names get new indices, the slots bound to the old ones go.
+*/
+  static void
+clear_variable_names(void)
+{
+  tokenizer_clear_variables();
+  variables_unbind();
+}
+
+/*
+  Point the tokenizer at the line the program cursor is on.
+*/
+static void
+bind_line(void)
+{
+  __line = __program.number;
+  if ( ! tokenizer_cache_lookup(&__tokenizer, __line, lines_generation()) )
+  {
+    tokenizer_cache_store(&__tokenizer, __line, __program.contents, lines_generation());
+  }
+}
+
 static void
 set_line( uint16_t line_number )
 {
-  __line = line_number;
-  char *cursor = lines_get_contents( __line );
-  tokenizer_char_pointer( cursor );
+  lines_cursor_seek(&__program, line_number);
+  bind_line();
+}
+
+/*
+  Continue at the line after the current one, returns false at the end of
+  the program.
+*/
+static bool
+next_line(void)
+{
+  bool found = lines_cursor_next(&__program);
+  bind_line();
+  return found;
+}
+
+/*
+  Jump targets
+
+  GOTO, GOSUB, ON ... GOTO/GOSUB and IF ... THEN n resolve their target line
+  once. The result is kept in a small table, indexed by the jump site (where
+  the line number sits in the program text). An entry is only used for the
+  same target number and the same program generation, any edit of the
+  program invalidates them all.
+*/
+
+#ifndef _WIN32
+#  if ARCH!=ARCH_XMEGA
+#    define JUMP_CACHE_SIZE 64
+#  endif
+#else
+#  define JUMP_CACHE_SIZE 64
+#endif
+
+#ifdef JUMP_CACHE_SIZE
+typedef struct
+{
+  char* site;
+  uint16_t line;
+  lines_cursor cursor;
+} jump_target;
+
+static jump_target __jumps[JUMP_CACHE_SIZE];
+
+// Jumps that had to seek their line, the unit tests look at it
+size_t __jump_seeks = 0;
+#endif
+
+  static bool
+resolve_jump(char* site, uint16_t line_number, lines_cursor* cursor)
+{
+#ifdef JUMP_CACHE_SIZE
+  jump_target* target = &__jumps[ (uintptr_t) site % JUMP_CACHE_SIZE ];
+  if ( target->site != site
+    || target->line != line_number
+    || target->cursor.generation != lines_generation() )
+  {
+    target->site = site;
+    target->line = line_number;
+    lines_cursor_seek(&target->cursor, line_number);
+    __jump_seeks++;
+  }
+  *cursor = target->cursor;
+  return cursor->contents != NULL;
+#else
+  return lines_cursor_seek(cursor, line_number);
+#endif
+}
+
+/*
+  Continue at the start of a resolved line.
+*/
+  static void
+jump_to_cursor(lines_cursor* cursor)
+{
+  __program = *cursor;
+  bind_line();
 }
 
-static float numeric_expression(void);
-static char* string_expression(void);
+/*
+  Continue at the start of a line the program jumps to, returns false when
+  the line doesn't exist.
+*/
+  static bool
+jump_to_line(char* site, uint16_t line_number)
+{
+  lines_cursor cursor;
+  if ( ! resolve_jump(site, line_number, &cursor) )
+  {
+    return false;
+  }
+  jump_to_cursor(&cursor);
+  return true;
+}
+
+/*
+  Where the tokenizer is now, for GOSUB and FOR to come back to.
+*/
+  static line_position
+get_line_position(void)
+{
+  char* p = tokenizer_char_pointer(&__tokenizer, NULL);
+  line_position position;
+  position.line = __line;
+  position.offset = 0;
+  position.typed = NULL;
+  if ( tokenizer_get_position(&__tokenizer).crunched )
+  {
+    position.offset = p - __program.contents;
+  }
+  else
+  {
+    position.typed = p;
+  }
+  return position;
+}
+
+/*
+  Continue at a position saved by GOSUB or FOR, returns false when its line
+  is gone.
+*/
+  static bool
+set_line_position(line_position* position)
+{
+  if ( position->typed != NULL )
+  {
+    set_line( position->line );
+    tokenizer_init(&__tokenizer, position->typed);
+    return true;
+  }
+  lines_cursor cursor;
+  if ( ! lines_cursor_seek(&cursor, position->line)
+    || position->offset > strlen(cursor.contents) )
+  {
+    return false;
+  }
+  jump_to_cursor(&cursor);
+  tokenizer_char_pointer(&__tokenizer, __program.contents + position->offset);
+  return true;
+}
+
+static numeric_value numeric_value_expression(void);
+static basic_number numeric_expression(void);
+static bool string_expression(string_value* string);
+
+  static numeric_value
+numeric_float(basic_number number)
+{
+  numeric_value n;
+  n.is_integer = false;
+  n.value.number = number;
+  return n;
+}
+
+  static numeric_value
+numeric_integer(int64_t integer)
+{
+  if ( integer < INT32_MIN || integer > INT32_MAX )
+  {
+    return numeric_float(integer);
+  }
+  numeric_value n;
+  n.is_integer = true;
+  n.value.integer = integer;
+  return n;
+}
+
+  static basic_number
+numeric_to_float(numeric_value n)
+{
+  return n.is_integer ? n.value.integer : n.value.number;
+}
+
+  static int32_t
+numeric_to_integer(numeric_value n)
+{
+  return n.is_integer ? n.value.integer : variable_float_to_integer(n.value.number);
+}
 
 void
 expression(expression_result *result)
 {
   // printf("expression\n");
-  char *string = string_expression();
-  if ( NULL != string )
+  string_value string;
+  if ( string_expression(&string) )
   {
     // Got string, check for relop and apply
     relop op = get_relop();
@@ -318,18 +625,19 @@ expression(expression_result *result)
     }
     else
     {
-      char *string_right = string_expression();
+      string_value string_right;
+      string_expression(&string_right);
       result->type = expression_type_numeric;
-      result->value.numeric = string_condition(string, string_right, op);
-      free(string_right);
-      free(string);
+      result->value.numeric = numeric_integer(string_condition(string.slice, string_right.slice, op));
+      string_free(&string_right);
+      string_free(&string);
     }
   }
   else
   {
     // printf("numeric");
     result->type = expression_type_numeric;
-    result->value.numeric = numeric_expression();
+    result->value.numeric = numeric_value_expression();
   }
 }
 
@@ -338,13 +646,19 @@ expression_print(expression_result* expr)
 {
   if (expr->type == expression_type_string)
   {
-    basic_io_print(expr->value.string);
+    basic_io_write(expr->value.string.slice.string, expr->value.string.slice.length);
   }
   else
     if (expr->type == expression_type_numeric)
     {
       char buffer[16];
-      float value = expr->value.numeric;
+      if (expr->value.numeric.is_integer)
+      {
+        snprintf(buffer, sizeof(buffer), "%ld", (long) expr->value.numeric.value.integer);
+        basic_io_print(buffer);
+        return;
+      }
+      basic_number value = expr->value.numeric.value.number;
       long ivalue = (int) value;
       if (ivalue == value)
       {
@@ -411,7 +725,7 @@ static int
 f_sqr(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = (float) sqrt( (double) n->value.number );
+  rv->value.number = number_sqrt(n->value.number);
   return 0;
 }
 
@@ -439,7 +753,7 @@ static int
 f_not(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = (float) ( ~ (int) n->value.number );
+  rv->value.number = (basic_number) ( ~ (int) n->value.number );
   return 0;
 }
 
@@ -447,7 +761,7 @@ static int
 f_sin(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = sinf(n->value.number);
+  rv->value.number = number_sin(n->value.number);
   return 0;
 }
 
@@ -455,7 +769,7 @@ static int
 f_cos(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = cosf(n->value.number);
+  rv->value.number = number_cos(n->value.number);
   return 0;
 }
 
@@ -463,7 +777,7 @@ static int
 f_tan(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = tanf(n->value.number);
+  rv->value.number = number_tan(n->value.number);
   return 0;
 }
 
@@ -471,7 +785,7 @@ static int
 f_log(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = logf(n->value.number);
+  rv->value.number = number_log(n->value.number);
   return 0;
 }
 
@@ -479,7 +793,7 @@ static int
 f_exp(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = expf(n->value.number);
+  rv->value.number = number_exp(n->value.number);
   return 0;
 }
 
@@ -487,7 +801,7 @@ static int
 f_pow(basic_type* x, basic_type* y, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = powf(x->value.number, y->value.number);
+  rv->value.number = number_pow(x->value.number, y->value.number);
   return 0;
 }
 
@@ -495,20 +809,20 @@ static int
 f_atn(basic_type* n, basic_type* rv)
 {
   rv->kind = kind_numeric;
-  rv->value.number = atanf(n->value.number);
+  rv->value.number = number_atan(n->value.number);
   return 0;
 }
 
-static float
-_or(float a, float b)
+static numeric_value
+_or(numeric_value a, numeric_value b)
 {
-  return (float) ( (int) a | (int) b );
+  return numeric_integer( numeric_to_integer(a) | numeric_to_integer(b) );
 }
 
-static float
-_and(float a, float b)
+static numeric_value
+_and(numeric_value a, numeric_value b)
 {
-  return (float) ( (int) a & (int) b );
+  return numeric_integer( numeric_to_integer(a) & numeric_to_integer(b) );
 }
 
 static int
@@ -591,14 +905,14 @@ expect(token t)
   return false;
 }
 
-static float factor(void);
+static numeric_value factor(void);
 
-static float
+static numeric_value
 numeric_factor(void)
 {
   // printf("  factor: %ld\n", sym);
 
-  float number = 0;
+  numeric_value number = numeric_integer(0);
   basic_function* bf;
   if ( (bf = find_basic_function_by_type(sym, basic_function_type_numeric)) != NULL ) {
     basic_type rv;
@@ -607,36 +921,44 @@ numeric_factor(void)
     {
       error("EXPECTED NUMERIC FACTOR");
     }
-    number = rv.value.number;
+    number = numeric_float(rv.value.number);
   } else if (sym == T_NUMBER) {
-    number = tokenizer_get_number();
+    basic_number literal = tokenizer_get_number(&__tokenizer);
+    // Half open, the bounds are exact in float as well
+    if ( literal >= -2147483648.0f && literal < 2147483648.0f && literal == (int32_t) literal )
+    {
+      number = numeric_integer((int32_t) literal);
+    }
+    else
+    {
+      number = numeric_float(literal);
+    }
     accept(T_NUMBER);
   } else if (sym == T_VARIABLE_NUMBER) {
-      char var_name[tokenizer_variable_length];
-      tokenizer_get_variable_name(var_name);
+      variable_ref ref = get_variable_ref();
       get_sym();
       if (sym == T_LEFT_BANANA)
       {
         // printf("is array\n");  
-        //var_name = realloc(var_name, strlen(var_name)+2);
-        //var_name = strcat(var_name, "(");
-        size_t l = strlen(var_name);
-        var_name[l] = '(';
-        var_name[l+1] = '\0';
-        // printf("name: %s\n", var_name);
         accept(T_LEFT_BANANA);
         size_t vector[5];
         get_vector(vector,5);
-        number = variable_array_get_numeric(var_name, vector);
+        variable* var = bind_variable(&ref, true);
+        number = ref.integer
+          ? numeric_integer(variable_element_integer(var, vector))
+          : numeric_float(variable_element_numeric(var, vector));
         expect(T_RIGHT_BANANA);
       }
       else
       {
-    number = variable_get_numeric(var_name);
+    variable* var = bind_variable(&ref, false);
+    number = ref.integer
+      ? numeric_integer(variable_integer(var))
+      : numeric_float(variable_numeric(var));
     accept(T_VARIABLE_NUMBER);
     }
   } else if (accept(T_LEFT_BANANA)) {
-    number = numeric_expression();
+    number = numeric_value_expression();
     expect(T_RIGHT_BANANA);
   } else {
     error("FACTOR SYNTAX ERROR");
@@ -646,51 +968,60 @@ numeric_factor(void)
   relop op = get_relop();
   if (op != OP_NOP)
   {
-    float right_number = factor();    
-    number = numeric_condition(number, right_number, op);
+    numeric_value right_number = factor();    
+    number = numeric_integer(numeric_condition(number, right_number, op));
   }
 
   return number; 
 }
 
-static float
+static numeric_value
 factor(void)
 {
   if ( sym == T_STRING || sym == T_VARIABLE_STRING ) {
-    char* s1 = string_term(); 
+    string_value s1;
+    string_term(&s1);
     relop op = get_relop();
     if (op == OP_NOP)
     {
-      free(s1);
+      string_free(&s1);
       error("EXPECTED RELOP");
-      return 0;
+      return numeric_integer(0);
     }
-    char* s2 = string_term();
-    float r = string_condition(s1, s2, op);
-    free(s2);
-    free(s1);
-    return r;
+    string_value s2;
+    string_term(&s2);
+    bool r = string_condition(s1.slice, s2.slice, op);
+    string_free(&s2);
+    string_free(&s1);
+    return numeric_integer(r);
   } else {
     return numeric_factor();
   }
 }
 
-static float
+static numeric_value
 term(void)
 {
   // printf("term\n");
 
-  float f1 = factor();
+  numeric_value f1 = factor();
   while (sym == T_MULTIPLY || sym == T_DIVIDE || sym == t_op_and ) {
     token operator = sym;
     get_sym();
-    float f2 = factor();
+    numeric_value f2 = factor();
     switch(operator) {
       case T_MULTIPLY:
-        f1 = f1 * f2;
+        if (f1.is_integer && f2.is_integer)
+        {
+          f1 = numeric_integer( (int64_t) f1.value.integer * f2.value.integer );
+        }
+        else
+        {
+          f1 = numeric_float( numeric_to_float(f1) * numeric_to_float(f2) );
+        }
         break;
       case T_DIVIDE:
-        f1 = f1 / f2;
+        f1 = numeric_float( numeric_to_float(f1) / numeric_to_float(f2) );
         break;
       default:
         if (operator == t_op_and)
@@ -706,8 +1037,8 @@ term(void)
   return f1;
 }
 
-static float
-numeric_expression(void)
+static numeric_value
+numeric_value_expression(void)
 {
   // printf("numeric expression?\n");
 
@@ -717,20 +1048,34 @@ numeric_expression(void)
     get_sym();
   }
   // printf("get term 1\n");
-  float t1 = term();
+  numeric_value t1 = term();
   if (operator == T_MINUS) {
-    t1 = -1 * t1;
+    t1 = t1.is_integer ? numeric_integer( - (int64_t) t1.value.integer ) : numeric_float( - t1.value.number );
   }
   while ( sym == T_PLUS || sym == T_MINUS || sym == t_op_or ) {
     operator = sym;
     get_sym();
-    float t2 = term();
+    numeric_value t2 = term();
     switch(operator) {
       case T_PLUS:
-        t1 = t1 + t2;
+        if (t1.is_integer && t2.is_integer)
+        {
+          t1 = numeric_integer( (int64_t) t1.value.integer + t2.value.integer );
+        }
+        else
+        {
+          t1 = numeric_float( numeric_to_float(t1) + numeric_to_float(t2) );
+        }
         break;
       case T_MINUS:
-        t1 = t1 - t2;
+        if (t1.is_integer && t2.is_integer)
+        {
+          t1 = numeric_integer( (int64_t) t1.value.integer - t2.value.integer );
+        }
+        else
+        {
+          t1 = numeric_float( numeric_to_float(t1) - numeric_to_float(t2) );
+        }
         break;
       default:
         if ( operator == t_op_or )
@@ -744,11 +1089,20 @@ numeric_expression(void)
     }
   }
   
-  // printf("expression: %f\n", t1);
-  
   return t1;
 }
 
+static basic_number
+numeric_expression(void)
+{
+  return numeric_to_float(numeric_value_expression());
+}
+
+static int32_t
+integer_expression(void)
+{
+  return numeric_to_integer(numeric_value_expression());
+}
 
 static void
 ready(void)
@@ -758,12 +1112,41 @@ ready(void)
   }
 }
 
+/*
+  Expand a crunched line into the scratch arena. The buffer starts at
+  MAX_EXPANDED bytes and doubles until the line fits.
+*/
+  static char*
+expand_line(char* contents)
+{
+  size_t size = MAX_EXPANDED;
+  for(;;)
+  {
+    arena_mark mark = arena_get_mark(__scratch);
+    char* expanded = arena_alloc(__scratch, size);
+    if ( expanded == NULL || tokenizer_expand(contents, expanded, size) )
+    {
+      return expanded;
+    }
+    arena_reset(__scratch, mark);
+    size *= 2;
+  }
+}
+
 static void
 list_out(uint16_t number, char* contents)
 {
-  char buffer[tokenizer_string_length];
-  snprintf(buffer, sizeof(buffer), "%d %s\n", number, contents);
+  arena_mark mark = arena_get_mark(__scratch);
+  char* expanded = expand_line(contents);
+  char buffer[8];
+  snprintf(buffer, sizeof(buffer), "%u ", number);
   basic_io_print(buffer);
+  if ( expanded != NULL )
+  {
+    basic_io_print(expanded);
+  }
+  __putch('\n');
+  arena_reset(__scratch, mark);
 }
 
 static int
@@ -775,14 +1158,14 @@ do_list(basic_type* rv)
   accept(t_keyword_list);
   if(sym == T_NUMBER)
   {
-    start = (uint16_t) tokenizer_get_number();
+    start = (uint16_t) tokenizer_get_number(&__tokenizer);
     accept(T_NUMBER);
     if(sym==T_MINUS)
     {
       accept(T_MINUS);
       if(sym==T_NUMBER)
       {
-        end = (uint16_t) tokenizer_get_number();
+        end = (uint16_t) tokenizer_get_number(&__tokenizer);
         accept(T_NUMBER);
       }
     }
@@ -799,48 +1182,62 @@ do_clear(basic_type* rv)
 {
   accept(t_keyword_clear);
   lines_clear();
+  clear_variable_names();
+  variables_clear();
+  // FOR frames point at the variables
+  __stack_p = __stack_size;
   ready();
   return 0;
 }
 
-static char*
-string_term(void)
+  static void
+string_borrow(string_value* string, char* s)
 {
-  char *string = NULL;
-  char var_name[tokenizer_variable_length];
+  string->slice.string = s;
+  string->slice.length = strlen(s);
+  string->mallocd = false;
+}
+
+  static void
+string_free(string_value* string)
+{
+  if (string->mallocd)
+  {
+    free(string->slice.string);
+    string->mallocd = false;
+  }
+}
+
+static bool
+string_term(string_value* string)
+{
+  variable_ref ref;
 
   switch (sym)
   {
     case T_STRING:
-      string = C_STRDUP(tokenizer_get_string());
+      string->slice = tokenizer_get_string(&__tokenizer);
+      string->mallocd = false;
       accept(T_STRING);
-      break;
+      return true;
     case T_VARIABLE_STRING:
-      tokenizer_get_variable_name(var_name);
+      ref = get_variable_ref();
       get_sym();
       if (sym == T_LEFT_BANANA)
       {
-        // printf("is array\n");  
-        // var_name = realloc(var_name, strlen(var_name)+2);
-        // var_name = strcat(var_name, "(");
-        size_t l = strlen(var_name);
-        var_name[l] = '(';
-        var_name[l+1] = '\0';
-        // printf("name: %s\n", var_name);
         accept(T_LEFT_BANANA);
         size_t vector[5];
         get_vector(vector,5);
-        string = C_STRDUP(variable_array_get_string(var_name, vector));
-        if (string == NULL) string = &_dummy;
-
+        char* s = variable_element_string(bind_variable(&ref, true), vector);
+        string_borrow(string, s ? s : "");
         expect(T_RIGHT_BANANA);
       }
       else
       {
-        string = C_STRDUP(variable_get_string(var_name));
+        string_borrow(string, variable_string(bind_variable(&ref, false)));
         accept(T_VARIABLE_STRING);
       }
-      break;
+      return true;
     default:
       {
         basic_function* bf = find_basic_function_by_type(sym, basic_function_type_string);
@@ -851,33 +1248,55 @@ string_term(void)
           if (rv.kind != kind_string)
           {
             error("EXPECTED STRING TERM");
+            string_borrow(string, "");
+            return true;
           }
-          string = C_STRDUP(rv.value.string);
-          if(rv.mallocd==true) free(rv.value.string);
+          string_borrow(string, rv.value.string);
+          if ( ! rv.mallocd )
+          {
+            // Might be a shared buffer, take a copy
+            string->slice.string = C_STRDUP(rv.value.string);
+          }
+          string->mallocd = true;
+          return true;
         }
       }
       break;
   }
 
-  return string;
+  return false;
 }
 
-static char*
-string_expression(void)
+static bool
+string_expression(string_value* string)
 {
-  char* s1 = string_term();
+  if ( ! string_term(string) )
+  {
+    return false;
+  }
 
   while (sym == T_PLUS)
   {
     accept(T_PLUS);
-    char *s2 = string_term();
-    size_t len = strlen(s1) + strlen(s2) + 1;
-    s1 = realloc(s1, len);
-    s1 = strcat(s1, s2);
-    free(s2);
+    string_value s2;
+    if ( ! string_term(&s2) )
+    {
+      error("EXPECTED STRING TERM");
+      break;
+    }
+    size_t length = string->slice.length + s2.slice.length;
+    char* s = malloc(length + 1);
+    memcpy(s, string->slice.string, string->slice.length);
+    memcpy(s + string->slice.length, s2.slice.string, s2.slice.length);
+    s[length] = '\0';
+    string_free(&s2);
+    string_free(string);
+    string->slice.string = s;
+    string->slice.length = length;
+    string->mallocd = true;
   }
  
-  return s1; 
+  return true; 
 }
 
 
@@ -908,8 +1327,7 @@ do_print(basic_type* rv)
         expression(&expr);
         expression_print(&expr);
         if (expr.type == expression_type_string){
-            if (expr.value.string != &_dummy)
-                free(expr.value.string);
+          string_free(&expr.value.string);
         }
       }
 
@@ -990,22 +1408,24 @@ do_goto(basic_type* rv)
     return 0;
   }
 
-  int line_number = (int) tokenizer_get_number();
+  int line_number = (int) tokenizer_get_number(&__tokenizer);
+  char* site = tokenizer_char_pointer(&__tokenizer, NULL);
   accept(T_NUMBER);
 
-  char* line = lines_get_contents(line_number);
-  if (line == NULL) {
+  if ( ! jump_to_line(site, line_number) ) {
     error("GOTO LINE NOT FOUND");
     return 0;
   }
 
-  set_line( line_number );
-
   return 0;
 }
 
+/*
+  Read a list of numbers, sites gets the program text position of every
+  entry.
+*/
   static size_t
-get_list(size_t* list, size_t max_size)
+get_list(size_t* list, char** sites, size_t max_size)
 {
   // printf("get list\n");
   size_t size = 0;
@@ -1015,16 +1435,17 @@ get_list(size_t* list, size_t max_size)
     {
       accept(T_COMMA);
     }
-    //printf(" sym: %ld\n", sym);
-    float n = numeric_expression();
-    //printf(" l[%ld] = %d\n", size, (int)n);
-    list[size] = n;
-    size++;
-    if (size>max_size)
+    if (size>=max_size)
     {
       error("LIST MAX SIZE");
       return size;
     }
+    //printf(" sym: %ld\n", sym);
+    sites[size] = tokenizer_char_pointer(&__tokenizer, NULL);
+    basic_number n = numeric_expression();
+    //printf(" l[%ld] = %d\n", size, (int)n);
+    list[size] = n;
+    size++;
   } while (sym == T_COMMA);
 
   return size;
@@ -1050,23 +1471,29 @@ do_on_goto(basic_type* rv)
   accept(what);
 
   size_t list[10];
-  size_t size = get_list(list, 10);
+  char* sites[10];
+  size_t size = get_list(list, sites, 10);
 
-  if(index>size){
+  if(index<1 || index>size){
     error("ON OUT OF BOUNDS");
     return 0;
   }
 
   size_t line_number = list[index-1];  
+  // Every entry in the list is a jump site of its own
+  char* site = sites[index-1];
   if (what == t_keyword_goto){
-    //TODO: refactor to helper and use in goto as well
-    char* line = lines_get_contents(line_number);
-    if (line == NULL) {
+    if ( ! jump_to_line(site, line_number) ) {
       error("LINE NOT FOUND");
     }
-    set_line( line_number );
   } else {
     //TODO: refactor to helper and use in gosub as well
+    lines_cursor target;
+    if ( ! resolve_jump(site, line_number, &target) ) {
+      error("LINE NOT FOUND");
+      return 0;
+    }
+
     stack_frame_gosub *g;
     if ( __stack_p < sizeof(stack_frame_gosub) )
     {
@@ -1078,9 +1505,8 @@ do_on_goto(basic_type* rv)
     g = (stack_frame_gosub*) &(__stack[__stack_p]);
 
     g->type = stack_frame_type_gosub;
-    g->line = __line;
-    g->cursor = tokenizer_char_pointer(NULL); 
-    set_line( line_number );
+    g->position = get_line_position();
+    jump_to_cursor(&target);
   }
   return 0;
 }
@@ -1096,10 +1522,17 @@ do_gosub(basic_type* rv)
     error("EXPECTED NUMBER");
     return 0;
   }
-  int line_number = (int) tokenizer_get_number();
+  int line_number = (int) tokenizer_get_number(&__tokenizer);
   // printf("line number: %d\n", line_number);
+  char* site = tokenizer_char_pointer(&__tokenizer, NULL);
   accept(T_NUMBER);
 
+  lines_cursor target;
+  if ( ! resolve_jump(site, line_number, &target) ) {
+    error("GOSUB LINE NOT FOUND");
+    return 0;
+  }
+
   stack_frame_gosub *g;
   if ( __stack_p < sizeof(stack_frame_gosub) )
   {
@@ -1111,10 +1544,9 @@ do_gosub(basic_type* rv)
   g = (stack_frame_gosub*) &(__stack[__stack_p]);
 
   g->type = stack_frame_type_gosub;
-  g->line = __line;
-  g->cursor = tokenizer_char_pointer(NULL); 
+  g->position = get_line_position();
 
-  set_line( line_number );
+  jump_to_cursor(&target);
 
   return 0;
 }
@@ -1128,17 +1560,19 @@ do_return(basic_type* rv)
   stack_frame_gosub *g;
   g = (stack_frame_gosub*) &(__stack[__stack_p]);
 
-  if ( g->type != stack_frame_type_gosub )
+  if ( __stack_p >= __stack_size || g->type != stack_frame_type_gosub )
   {
     error("EXPECTED GOSUB STACK FRAME");
     return 0;
   }
 
-  __line = g->line;
-  tokenizer_char_pointer( g->cursor );
-
   __stack_p += sizeof(stack_frame_gosub);
 
+  if ( ! set_line_position(&g->position) )
+  {
+    error("RETURN LINE NOT FOUND");
+  }
+
   return 0;
 }
 
@@ -1154,40 +1588,62 @@ do_for(basic_type* rv)
     return 0;
   }
 
-  char name[tokenizer_variable_length];
-  tokenizer_get_variable_name(name);
+  variable_ref ref = get_variable_ref();
   get_sym();
   expect(T_EQUALS);
-  float value = numeric_expression();
-  variable_set_numeric(name, value);
+  numeric_value value = numeric_value_expression();
+  variable* var = bind_variable(&ref, false);
+  if (ref.integer)
+  {
+    variable_store_integer(var, numeric_to_integer(value));
+  }
+  else
+  {
+    variable_store_numeric(var, numeric_to_float(value));
+  }
 
   expect(t_keyword_to);
   
-  float end_value = numeric_expression();
+  numeric_value end_value = numeric_value_expression();
 
-  float step = 1.0;
+  numeric_value step = numeric_integer(1);
   if (sym != T_EOF && sym != T_COLON)
   {
     expect(t_keyword_step);
-    step = numeric_expression();
+    step = numeric_value_expression();
   }  
 
   stack_frame_for *f;
-  if ( __stack_p <  sizeof(stack_frame_for) )
+  size_t name_length = ref.name.length;
+  size_t size = STACK_ALIGN(sizeof(stack_frame_for) + name_length + 1);
+  if ( __stack_p < size )
   {
     error("STACK FULL");
     return 0;
   }  
 
-  __stack_p -= sizeof(stack_frame_for);
+  __stack_p -= size;
   f = (stack_frame_for*) &(__stack[__stack_p]);
   
   f->type = stack_frame_type_for;
-  strncpy(f->variable_name, name, tokenizer_variable_length);
-  f->end_value = end_value;
-  f->step = step;
-  f->line = __line;
-  f->cursor = tokenizer_char_pointer(NULL); 
+  f->size = size;
+  memcpy(f->variable_name, ref.name.string, name_length);
+  f->variable_name[name_length] = '\0';
+  if (ref.integer)
+  {
+    f->value.integer = variable_integer_storage(var);
+    f->end_value = numeric_integer(numeric_to_integer(end_value));
+    f->step = numeric_integer(numeric_to_integer(step));
+  }
+  else
+  {
+    f->value.number = variable_numeric_storage(var);
+    f->end_value = numeric_float(numeric_to_float(end_value));
+    f->step = numeric_float(numeric_to_float(step));
+  }
+  f->program = __program;
+  f->body = get_line_position();
+  f->position = tokenizer_get_position(&__tokenizer);
 
   return 0;
 }
@@ -1201,7 +1657,7 @@ do_next(basic_type* rv)
   stack_frame_for *f;
   f = (stack_frame_for*) &(__stack[__stack_p]);
 
-  if ( f->type != stack_frame_type_for )
+  if ( __stack_p >= __stack_size || f->type != stack_frame_type_for )
   {
     error("EXPECTED FOR STACK FRAME");
     return 0;
@@ -1209,30 +1665,56 @@ do_next(basic_type* rv)
 
   if (sym == T_VARIABLE_NUMBER)
   {
-    char var_name[tokenizer_variable_length];
-    tokenizer_get_variable_name(var_name);
+    variable_ref ref = get_variable_ref();
     accept(T_VARIABLE_NUMBER);
-    if ( strcmp(var_name, f->variable_name) != 0 )
+    if ( variable_numeric_storage(bind_variable(&ref, false)) != f->value.number )
     {
       char _error[40];
-      snprintf(_error, sizeof(_error), "EXPECTED NEXT WITH %s, GOT %s", var_name, f->variable_name);
+      snprintf(_error, sizeof(_error), "EXPECTED NEXT WITH %.*s, GOT %s", (int) ref.name.length, ref.name.string, f->variable_name);
       error(_error);
       return 0;
     }
   }
 
   // check end condition 
-  float value = variable_get_numeric(f->variable_name) + f->step;
-  if ( (f->step > 0 && value > f->end_value) || (f->step < 0 && value < f->end_value) )
+  if (f->step.is_integer)
   {
-      __stack_p += sizeof(stack_frame_for);
+    int32_t step = f->step.value.integer;
+    int32_t end_value = f->end_value.value.integer;
+    int64_t value = (int64_t) *f->value.integer + step;
+    if ( (step > 0 && value > end_value) || (step < 0 && value < end_value) )
+    {
+      __stack_p += f->size;
       return 0;
+    }
+    *f->value.integer = value;
+  }
+  else
+  {
+    basic_number step = f->step.value.number;
+    basic_number end_value = f->end_value.value.number;
+    basic_number value = *f->value.number + step;
+    if ( (step > 0 && value > end_value) || (step < 0 && value < end_value) )
+    {
+      __stack_p += f->size;
+      return 0;
+    }
+    *f->value.number = value;
   }
 
-  variable_set_numeric(f->variable_name, value); 
-
-  __line = f->line;
-  tokenizer_char_pointer( f->cursor );
+  if ( f->program.generation == lines_generation() )
+  {
+    __program = f->program;
+    __line = __program.number;
+    if ( tokenizer_set_position(&__tokenizer, &f->position, lines_generation()) )
+    {
+      return 0;
+    }
+  }
+  if ( ! set_line_position(&f->body) )
+  {
+    error("NEXT LINE NOT FOUND");
+  }
 
   return 0;
 }
@@ -1248,7 +1730,7 @@ static int
 do_rem(basic_type* rv)
 {
   accept(t_keyword_rem);
-  set_line(lines_next(__line));
+  next_line();
   get_sym();
   return 0;
 }
@@ -1269,16 +1751,16 @@ get_vector(size_t* vector, size_t size)
   {
     // printf(" sym: %ld\n", sym);
     // expect(T_NUMBER);
-    // float n = tokenizer_get_number();
-    float n = numeric_expression();
+    // float n = tokenizer_get_number(&__tokenizer);
+    int32_t n = integer_expression();
     // printf(" dim %ld = %d\n", dimensions, (int) n);
-    vector[dimensions] = n;
-    dimensions++;
-    if (dimensions>size)
+    if (dimensions==size)
     {
       error("MAX DIM");
       return dimensions;
     }
+    vector[dimensions] = n;
+    dimensions++;
     // accept(T_NUMBER);
     if (sym == T_COMMA)
     {
@@ -1304,10 +1786,9 @@ do_dim(basic_type* rv)
     // printf(" s: %ld (%d,%d)\n", sym, T_VARIABLE_NUMBER, T_VARIABLE_STRING);
     if ( sym == T_VARIABLE_NUMBER || sym == T_VARIABLE_STRING )
     {
-      variable_type type = (sym == T_VARIABLE_STRING) ? variable_type_string : variable_type_numeric ;
+      variable_type type = variable_name_type(tokenizer_get_variable_name(&__tokenizer));
       size_t vector[5];
-      char name[tokenizer_variable_length];
-      tokenizer_get_variable_name(name);
+      char* name = get_variable_name();
 
       size_t l = strlen(name);
       name[l] = '(';
@@ -1343,81 +1824,83 @@ do_data(basic_type* rv)
   return 0;
 }
 
+  static void
+_data_value(variable_type type, data_value* value)
+{
+  if (type == variable_type_string)
+  {
+    value->string = tokenizer_get_string(&__data.tokenizer);
+  }
+  else
+  {
+    value->number = tokenizer_get_number(&__data.tokenizer);
+  }
+}
+
   static bool
-_data_find(variable_type type, value* value)
+_data_find(variable_type type, data_value* value)
 {
-  tokenizer_init( __data.cursor );
-  tokenizer_char_pointer( __data.char_pointer );
-  while (__data.cursor)
+  char* cursor = __data.tokenizer.line;
+  while (cursor)
   {
-    get_sym();
-    while (sym != T_EOF)
+    token t = tokenizer_get_next_token(&__data.tokenizer);
+    while (t != T_EOF)
     {
-      if (sym == t_keyword_data)
+      if (t == t_keyword_data)
       {
-        accept(t_keyword_data);
-        if (type == variable_type_string)
-        {
-          value->string = tokenizer_get_string();
-        } else {
-          value->number = tokenizer_get_number();
-        }  
+        tokenizer_get_next_token(&__data.tokenizer);
+        _data_value(type, value);
         __data.state = data_state_read;
-        __data.char_pointer = tokenizer_char_pointer(NULL);
         return true;
       }
-      get_sym();
+      t = tokenizer_get_next_token(&__data.tokenizer);
+    }
+    lines_cursor_next(&__data.line);
+    cursor = __data.line.contents;
+    if (cursor)
+    {
+      tokenizer_init_crunched(&__data.tokenizer, cursor);
     }
-    __data.line = lines_next(__data.line);
-    __data.cursor = lines_get_contents(__data.line);
-    tokenizer_init(__data.cursor);
   }
   return false;
 }  
 
   static bool
-_data_read(variable_type type, value* value)
+_data_read(variable_type type, data_value* value)
 {
-  bool rv = false;
-
-  tokenizer_init( __data.cursor );
-  tokenizer_char_pointer( __data.char_pointer );
-  get_sym();
-  if ( sym != T_EOF )
+  token t = tokenizer_get_next_token(&__data.tokenizer);
+  if ( t != T_EOF )
   {
-    accept(T_COMMA); // seperated by comma's
-    if (type == variable_type_string)
-    {
-      value->string = tokenizer_get_string();
-    }
-    else
+    // seperated by comma's
+    if (t == T_COMMA)
     {
-      value->number = tokenizer_get_number();
+      tokenizer_get_next_token(&__data.tokenizer);
     }
-    __data.char_pointer = tokenizer_char_pointer(NULL);
-    rv = true; 
-  }
-  else
-  {  
-    __data.cursor = lines_get_contents(__data.line);
+    _data_value(type, value);
+    return true;
   }
-  return rv;
+  return false;
 }  
 
   static bool
-_do_data_read(variable_type type, value* value)
+_do_data_read(variable_type type, data_value* value)
 {
-  char* save_pointer = tokenizer_char_pointer(NULL);
   bool rv = false;
 
   switch (__data.state)
   {
     case data_state_init:
-      __data.line = lines_first();
-      __data.cursor = lines_get_contents(__data.line);
-      __data.char_pointer = tokenizer_char_pointer(NULL);
-      __data.state = data_state_find;
-      rv = _data_find(type, value);
+      {
+        lines_cursor_first(&__data.line);
+        char* cursor = __data.line.contents;
+        if (cursor == NULL)
+        {
+          return false;
+        }
+        tokenizer_init_crunched(&__data.tokenizer, cursor);
+        __data.state = data_state_find;
+        rv = _data_find(type, value);
+      }
       break;
 
     case data_state_find:  
@@ -1438,9 +1921,6 @@ _do_data_read(variable_type type, value* value)
       }
   }
 
-  tokenizer_init( __cursor );
-  tokenizer_char_pointer(save_pointer);
-
   return rv;
 }
 
@@ -1461,51 +1941,49 @@ do_read(basic_type* rv)
     if ( sym == T_VARIABLE_NUMBER || sym == T_VARIABLE_STRING )
     {
       variable_type type = (sym == T_VARIABLE_STRING) ? variable_type_string : variable_type_numeric ;
-      char name[tokenizer_variable_length];
-      tokenizer_get_variable_name(name);
+      variable_ref ref = get_variable_ref();
       accept(sym);
       if (sym == T_LEFT_BANANA)
       {
         is_array = true;
-        //name = realloc(name, strlen(name)+2);
-        //name = strcat(name, "(");
-        size_t l = strlen(name);
-        name[l] = '(';
-        name[l+1] = '\0';
         accept(T_LEFT_BANANA);
         get_vector(vector,5);
         expect(T_RIGHT_BANANA);
       }
       // printf("variable name: %s\n", name);
-      value v;
+      data_value v;
       bool read_ok = _do_data_read(type, &v);
       if ( ! read_ok)
       {
         error("READ WITHOUT DATA");
         return 0;
       }
+      variable* var = bind_variable(&ref, is_array);
       if ( type == variable_type_string )
       {
         if (is_array)
         {
-         variable_array_set_string(name, v.string, vector);
+         variable_store_element_string(var, v.string, vector);
         }
         else
         {  
-          variable_set_string(name, v.string);
+          variable_store_string(var, v.string);
         }
       } else {
         if (is_array)
         {
-          variable_array_set_numeric(name, v.number, vector);
+          variable_store_element_numeric(var, v.number, vector);
         }
         else
         {
-          variable_set_numeric(name, v.number);
+          variable_store_numeric(var, v.number);
         }
       }
     }
-    get_sym();
+    else
+    {
+      get_sym();
+    }
     accept(T_COMMA);
   }
 
@@ -1517,8 +1995,6 @@ do_restore(basic_type* rv)
 {
   accept(t_keyword_restore);
   // __data.inited = false;
-  __data.line = 0;
-  __data.cursor = 0;
   __data.state = data_state_init;
   return 0;
 }
@@ -1551,8 +2027,44 @@ _trim(char* s)
   *(p+1) = '\0'; 
 }  
 
+/*
+  Crunch a line into the scratch arena. A crunched token takes at most 6
+  bytes (a tag and a 5 byte varint) for at least 1 character of text, a
+  double that is not an integer up to 13 bytes for at least 2.
+*/
+  static char*
+_crunch(char* contents)
+{
+  size_t size = 7 * strlen(contents) + 1;
+  if ( size > lines_max_length )
+  {
+    size = lines_max_length;
+  }
+  char* crunched = arena_alloc(__scratch, size);
+  if ( crunched == NULL || ! tokenizer_crunch(contents, crunched, size) )
+  {
+    error("LINE TOO LONG");
+    return NULL;
+  }
+  return crunched;
+}
+
   static void
-_store(char* line)
+_store_line(uint16_t number, char* contents)
+{
+  char* crunched = _crunch(contents);
+  if ( crunched == NULL )
+  {
+    return;
+  }
+  if ( ! lines_store(number, crunched) )
+  {
+    error("OUT OF PROGRAM MEMORY");
+  }
+}
+
+  static void
+_store(char* line, array* entries)
 {
   int number;
   sscanf(line, "%d", &number);
@@ -1566,17 +2078,34 @@ _store(char* line)
   }
   _trim(p);
   printf("%d %s\n", number, p);
-  lines_store((uint16_t)number, p);
+
+  // Collect the crunched line, the whole program is stored at once
+  char* crunched = _crunch(p);
+  if ( crunched == NULL )
+  {
+    return;
+  }
+  lines_entry entry;
+  entry.number = (uint16_t) number;
+  entry.contents = crunched;
+  array_push(entries, &entry);
 }  
 
   static void
 _load_cb(char* line, void* context)
 {
   if(!(is_empty(line) || is_comment(line))){
-    _store(line);
+    _store(line, (array*) context);
   }
 }  
 
+  static char*
+get_filename(void)
+{
+  slice name = tokenizer_get_string(&__tokenizer);
+  return arena_strndup(__scratch, name.string, name.length);
+}
+
   static int
 do_load(basic_type* rv)
 {
@@ -1585,27 +2114,87 @@ do_load(basic_type* rv)
     error("EXPECTED LITERAL STRING");
     return 0;
   }
-  char *filename = tokenizer_get_string();
+  char* filename = get_filename();
   accept(T_STRING);
   lines_clear();
-  arch_load(filename, _load_cb, NULL);
+  clear_variable_names();
+  array* entries = array_new(sizeof(lines_entry));
+  arch_load(filename, _load_cb, entries);
+  if ( ! lines_load(array_get(entries, 0), array_size(entries)) )
+  {
+    error("OUT OF PROGRAM MEMORY");
+  }
+  array_destroy(entries);
+  ready();
+
+  return 0;
+}
+
+/*
+  MERGE "name" stores the lines of a file into the program, in one pass. A
+  line number on its own deletes that line.
+*/
+/*
+  MERGE and DELETE move the lines, a running program goes on reading its
+  current line at the same place. When that line is gone, it stops.
+*/
+  static void
+rebind_line(line_position* position)
+{
+  static char end[] = "";
+  if ( position->typed == NULL && ! set_line_position(position) )
+  {
+    error("CURRENT LINE DELETED");
+    __RUNNING = false;
+    // Nothing of the old line is read any more
+    tokenizer_init(&__tokenizer, end);
+    get_sym();
+  }
+}
+
+  static int
+do_merge(basic_type* rv)
+{
+  accept(t_keyword_merge);
+  if (sym != T_STRING) {
+    error("EXPECTED LITERAL STRING");
+    return 0;
+  }
+  char* filename = get_filename();
+  accept(T_STRING);
+  line_position position = get_line_position();
+  array* entries = array_new(sizeof(lines_entry));
+  arch_load(filename, _load_cb, entries);
+  if ( ! lines_merge(array_get(entries, 0), array_size(entries)) )
+  {
+    error("OUT OF PROGRAM MEMORY");
+  }
+  array_destroy(entries);
+  rebind_line(&position);
   ready();
 
   return 0;
 }
 
 typedef struct {
-  uint16_t number;
+  lines_cursor cursor;
+  arena_mark mark;
 } _save_cb_ctx;
 
   static uint16_t 
 _save_cb(char** line, void* context)
 {
   _save_cb_ctx* ctx = (_save_cb_ctx*) context;
-  uint16_t number = ctx->number;
-  ctx->number = lines_next(number);
+  uint16_t number = ctx->cursor.number;
+  *line = ctx->cursor.contents;
+  lines_cursor_next(&ctx->cursor);
    
-  *line = lines_get_contents(number);
+  if ( *line != NULL )
+  {
+    // The previous line has been written, its expansion can go
+    arena_reset(__scratch, ctx->mark);
+    *line = expand_line(*line);
+  }
 
   return number;
 }  
@@ -1618,28 +2207,126 @@ do_save(basic_type* rv)
     error("EXPECTED LITERAL STRING");
     return 0;
   }
-  char *filename = tokenizer_get_string();
+  char* filename = get_filename();
   accept(T_STRING);
   _save_cb_ctx ctx;
-  ctx.number = lines_first();
+  lines_cursor_first(&ctx.cursor);
+  ctx.mark = arena_get_mark(__scratch);
   arch_save(filename, _save_cb, &ctx);
   ready();
 
   return 0;
 }
 
+#ifdef LINES_GROWABLE
+  static void
+image_error(image_status status)
+{
+  switch (status)
+  {
+    case image_ok:
+      break;
+    case image_io_error:
+      error("CANNOT ACCESS IMAGE");
+      break;
+    case image_invalid:
+      error("INVALID IMAGE");
+      break;
+    case image_incompatible:
+      error("INCOMPATIBLE IMAGE");
+      break;
+    case image_out_of_memory:
+      error("OUT OF MEMORY");
+      break;
+  }
+}
+
+/*
+  BSAVE "name"[,crunched] writes the program as a binary image. The body is
+  crunched unless the optional flag is 0, then it is plain text and loads
+  in builds with other keywords too.
+*/
+  static int
+do_bsave(basic_type* rv)
+{
+  accept(t_keyword_bsave);
+  if (sym != T_STRING) {
+    error("EXPECTED LITERAL STRING");
+    return 0;
+  }
+  char* filename = get_filename();
+  accept(T_STRING);
+  bool crunched = true;
+  if (sym == T_COMMA) {
+    accept(T_COMMA);
+    crunched = numeric_expression() != 0;
+  }
+  image_error(image_save(filename, crunched));
+  ready();
+
+  return 0;
+}
+
   static int
-do_delete(basic_type* rv)
+do_bload(basic_type* rv)
 {
-  accept(t_keyword_delete);
+  accept(t_keyword_bload);
   if (sym != T_STRING) {
     error("EXPECTED LITERAL STRING");
     return 0;
   }
-  char *filename = tokenizer_get_string();
+  char* filename = get_filename();
   accept(T_STRING);
+  image_status status = image_load(filename);
+  // The names of the image are interned again, over the old ones
+  variables_unbind();
+  image_error(status);
+  ready();
+
+  return 0;
+}
+#endif
+
+/*
+  DELETE "name" deletes a file, DELETE n[-[m]] or DELETE -m deletes a range
+  of program lines.
+*/
+  static int
+do_delete(basic_type* rv)
+{
+  accept(t_keyword_delete);
+  if (sym == T_STRING) {
+    char* filename = get_filename();
+    accept(T_STRING);
+    arch_delete(filename);
+    ready();
+    return 0;
+  }
 
-  arch_delete(filename);
+  if (sym != T_NUMBER && sym != T_MINUS) {
+    error("EXPECTED LITERAL STRING OR LINE NUMBER");
+    return 0;
+  }
+  uint16_t start = 0;
+  uint16_t end = 0;
+  if (sym == T_NUMBER) {
+    start = (uint16_t) tokenizer_get_number(&__tokenizer);
+    end = start;
+    accept(T_NUMBER);
+  }
+  if (sym == T_MINUS) {
+    accept(T_MINUS);
+    end = 0;
+    if (sym == T_NUMBER) {
+      end = (uint16_t) tokenizer_get_number(&__tokenizer);
+      accept(T_NUMBER);
+    }
+  }
+  line_position position = get_line_position();
+  if ( lines_delete_range(start, end) > 0 )
+  {
+    rebind_line(&position);
+  }
   ready();
 
   return 0;
@@ -1697,25 +2384,22 @@ static bool statement(void);
 static int
 do_run(basic_type* rv)
 {
-  __line = lines_first();
-  __cursor = lines_get_contents(__line);
-  tokenizer_init( __cursor );
+  lines_cursor_first(&__program);
+  tokenizer_init_crunched(&__tokenizer, __program.contents );
+  bind_line();
   __RUNNING = true;
   __STOPPED = false;
-  while (__cursor && __RUNNING)
+  while (__program.contents && __RUNNING)
   {
     // printf("stack available: %" PRIu16 "\n", __stack_p);
     // printf("memory used: %" PRIu16 "\n", lines_memory_used() );
     get_sym();
     if ( sym == T_EOF ) {
-      __line = lines_next(__line);
-      __cursor = lines_get_contents(__line);
-      if ( __cursor == NULL )
+      if ( ! next_line() )
       {
         __RUNNING = false;
         break;
       }
-      tokenizer_init( __cursor );
     }
     parse_line();
   }
@@ -1762,8 +2446,39 @@ get_relop(void)
 }
 
 static bool
-numeric_condition(float left, float right, relop op)
+integer_condition(int32_t left, int32_t right, relop op)
 {
+  switch(op) {
+    case OP_NOP:
+      error("EXPECTED RELOP");
+      break;
+    case OP_LT:
+      return left < right;
+    case OP_LE:
+      return left <= right;
+    case OP_EQ:
+      return left == right;
+    case OP_GE:
+      return left >= right;
+    case OP_GT:
+      return left > right;  
+    case OP_NE:
+      return left != right;
+  }
+
+  return false;
+}
+
+static bool
+numeric_condition(numeric_value left_value, numeric_value right_value, relop op)
+{
+  if (left_value.is_integer && right_value.is_integer)
+  {
+    return integer_condition(left_value.value.integer, right_value.value.integer, op);
+  }
+
+  basic_number left = numeric_to_float(left_value);
+  basic_number right = numeric_to_float(right_value);
 
   // printf("numeric condition %f, %f, %d\n", left, right, op);
 
@@ -1789,11 +2504,14 @@ numeric_condition(float left, float right, relop op)
 }
 
 static bool
-string_condition(char *left, char *right, relop op)
+string_condition(slice left, slice right, relop op)
 {
-  int comparison = strcmp(left, right);
-
-  // printf("String condition('%s','%s'): %d\n", left, right, comparison);
+  size_t length = left.length < right.length ? left.length : right.length;
+  int comparison = memcmp(left.string, right.string, length);
+  if (comparison == 0)
+  {
+    comparison = (left.length > right.length) - (left.length < right.length);
+  }
 
   switch(op) {
     case OP_NOP:
@@ -1834,7 +2552,7 @@ condition(expression_result *left_er, expression_result *right_er, relop op)
     {
       error("EXPECTED STRING RIGHT HAND TYPE");
     }
-    return string_condition(left_er->value.string, right_er->value.string, op);;
+    return string_condition(left_er->value.string.slice, right_er->value.string.slice, op);
   }
 }
 
@@ -1849,7 +2567,7 @@ move_to_next_statement(void)
 static void
 move_to_next_line(void)
 {
-  set_line(lines_next(__line));
+  next_line();
   get_sym();
 }
 
@@ -1867,10 +2585,15 @@ do_if(basic_type* rv)
     relop op = get_relop();
     expression(&right_side);
     result = condition(&left_side, &right_side, op);
+    string_free(&left_side.value.string);
+    if (right_side.type == expression_type_string)
+    {
+      string_free(&right_side.value.string);
+    }
   }
   else
   {
-    result = left_side.value.numeric == 1.0;
+    result = numeric_to_float(left_side.value.numeric) == 1.0;
   }
 
   if (sym != t_keyword_then) {
@@ -1883,9 +2606,13 @@ do_if(basic_type* rv)
 
     if ( sym == T_NUMBER )
     {
-      float line_number = tokenizer_get_number();
+      basic_number line_number = tokenizer_get_number(&__tokenizer);
+      char* site = tokenizer_char_pointer(&__tokenizer, NULL);
       accept(T_NUMBER);
-      set_line(line_number);
+      if ( ! jump_to_line(site, line_number) )
+      {
+        error("LINE NOT FOUND");
+      }
     }
     else
     { 
@@ -1912,19 +2639,13 @@ do_let(basic_type* rv)
     return 0;
   }
 
-  char name[tokenizer_variable_length];
-  tokenizer_get_variable_name(name);
+  variable_ref ref = get_variable_ref();
   token var_type = sym;
   get_sym();
   if (sym == T_LEFT_BANANA)
   {
     is_array = true;
     // printf("is array\n");  
-    // name = realloc(name, strlen(name)+2);
-    // name = strcat(name, "(");
-    size_t l = strlen(name);
-    name[l] = '(';
-    name[l+1] = '\0';
     accept(T_LEFT_BANANA);
     get_vector(vector, 5);
     expect(T_RIGHT_BANANA);
@@ -1933,37 +2654,78 @@ do_let(basic_type* rv)
 
   expect(T_EQUALS);
   
-  if (var_type == T_VARIABLE_NUMBER) {
+  if (var_type == T_VARIABLE_NUMBER && ref.integer) {
+    int32_t value = integer_expression();
+    variable* var = bind_variable(&ref, is_array);
+    if (is_array)
+    {
+      variable_store_element_integer(var, value, vector);
+    }
+    else
+    {
+      variable_store_integer(var, value);
+    }
+  }
+  else if (var_type == T_VARIABLE_NUMBER) {
     // printf("number\n");
-    float value = numeric_expression();
+    basic_number value = numeric_expression();
+    variable* var = bind_variable(&ref, is_array);
     if (is_array)
     {
-      variable_array_set_numeric(name, value, vector);
+      variable_store_element_numeric(var, value, vector);
     }
     else
     {
-      // printf("set %s to %f\n", name, value);
-      variable_set_numeric(name, value);
+      variable_store_numeric(var, value);
     }
   }
 
   if (var_type == T_VARIABLE_STRING) {
     // printf("string\n");
-    char *value = string_expression();
+    string_value value;
+    if ( ! string_expression(&value) )
+    {
+      error("EXPECTED STRING EXPRESSION");
+      return 0;
+    }
+    variable* var = bind_variable(&ref, is_array);
     if (is_array)
     {
-      variable_array_set_string(name, value, vector);
+      variable_store_element_string(var, value.slice, vector);
     }
     else
     {
-      variable_set_string(name, value);
+      variable_store_string(var, value.slice);
     }
-    free(value);
+    string_free(&value);
   }
 
   return 0;
 }
 
+/*
+  Read a line of input into the scratch arena. The buffer is doubled until
+  the whole line fits.
+*/
+  static char*
+read_input(char* prompt)
+{
+  size_t size = SCRATCH_CHUNK_SIZE / 2;
+  char* line = arena_alloc(__scratch, size);
+  basic_io_readline(prompt, line, size);
+  size_t length = strlen(line);
+  while (length == size - 1)
+  {
+    char* grown = arena_alloc(__scratch, size * 2);
+    memcpy(grown, line, length);
+    basic_io_readline("", &grown[length], size * 2 - length);
+    line = grown;
+    size *= 2;
+    length = strlen(line);
+  }
+  return line;
+}
+
   static int
 do_input(basic_type* rv)
 {
@@ -1985,38 +2747,40 @@ do_input(basic_type* rv)
     return 0;
   }
 
-  char name[tokenizer_variable_length];
+  variable_ref ref = get_variable_ref();
   token type = sym; 
-  if (type == T_VARIABLE_NUMBER) {
-    tokenizer_get_variable_name(name);
-    accept(T_VARIABLE_NUMBER);
-  }
-
-  if (type == T_VARIABLE_STRING) {
-    tokenizer_get_variable_name(name);
-    accept(T_VARIABLE_STRING);
-  }
+  accept(type);
 
   if (prompt)
   {
     expression_print(&expr);
     if (expr.type == expression_type_string){
-      free(expr.value.string);
+      string_free(&expr.value.string);
     }
   }
   // char* line = readline( prompt ? "" : "?" );
 
-  char line[MAX_LINE];
-  basic_io_readline( (prompt ? " " : "? "), line, sizeof(line) ); 
+  char* line = read_input( (prompt ? " " : "? ") );
 
-  if (type == T_VARIABLE_NUMBER) {
+  if (type == T_VARIABLE_NUMBER && ref.integer) {
     char* t;
-    float value = strtof(line, &t); 
-    variable_set_numeric(name, value);
+    long value = strtol(line, &t, 10);
+    if ( value < INT32_MIN || value > INT32_MAX )
+    {
+      error("OVERFLOW");
+      return 0;
+    }
+    variable_store_integer(bind_variable(&ref, false), value);
+  }
+  else if (type == T_VARIABLE_NUMBER) {
+    char* t;
+    basic_number value = number_strto(line, &t); 
+    variable_store_numeric(bind_variable(&ref, false), value);
   }
 
   if (type == T_VARIABLE_STRING) {
-    variable_set_string(name, line);
+    slice value = { line, strlen(line) };
+    variable_store_string(bind_variable(&ref, false), value);
   }
 
   return 0;
@@ -2030,8 +2794,7 @@ do_get(basic_type* rv)
     return 0;
   }
 
-  char name[tokenizer_variable_length];
-  tokenizer_get_variable_name(name);
+  variable_ref ref = get_variable_ref();
 
   accept(T_VARIABLE_STRING);
 
@@ -2044,7 +2807,8 @@ do_get(basic_type* rv)
     } 
     snprintf(c, sizeof(c), "%c", ch);
   }
-  variable_set_string(name, c);
+  slice value = { c, strlen(c) };
+  variable_store_string(bind_variable(&ref, false), value);
 
   return 0;
 }
@@ -2115,6 +2879,7 @@ parse_line(void)
 static bool
 statement(void)
 {
+  arena_mark mark = arena_get_mark(__scratch);
   switch(sym) {
     case T_ERROR:
       error("STATEMENT ERROR");
@@ -2137,6 +2902,7 @@ statement(void)
       }
       break;
   }
+  arena_reset(__scratch, mark);
   return last_error == NULL;
 }
 
@@ -2147,6 +2913,8 @@ void basic_destroy(void)
 	tokenizer_free_registered_tokens();
 	array_destroy(basic_tokens);
 	array_destroy(basic_functions);
+	arena_destroy(__scratch);
+	lines_destroy();
 	free(__stack);
 	free(__memory);
 }
@@ -2160,11 +2928,16 @@ void basic_init(size_t memory_size, size_t stack_size)
   //printf("- gosub: %" PRIu16 "\n", sizeof(stack_frame_gosub));
   //printf("__\n");
 
+#ifdef LINES_GROWABLE
+  // Program memory starts at memory_size and is grown by lines
+  __memory = NULL;
+#else
   __memory = malloc(memory_size);
   if(!__memory){
     error("CANNOT ALLOCATE PROGRAM SPACE");
     return;
   }
+#endif
   __memory_size = memory_size;
   __program_size = __memory_size;
 
@@ -2176,6 +2949,8 @@ void basic_init(size_t memory_size, size_t stack_size)
   __stack_size = stack_size;
   __stack_p = __stack_size;
 
+  __scratch = arena_new(SCRATCH_CHUNK_SIZE);
+
   __line = 0;
   __data.state = data_state_init;
 
@@ -2212,6 +2987,11 @@ void basic_init(size_t memory_size, size_t stack_size)
   t_keyword_save = register_function_0(basic_function_type_keyword, "SAVE", do_save);
   t_keyword_delete = register_function_0(basic_function_type_keyword, "DELETE", do_delete);
   t_keyword_dir = register_function_0(basic_function_type_keyword, "DIR", do_dir);
+  t_keyword_merge = register_function_0(basic_function_type_keyword, "MERGE", do_merge);
+#ifdef LINES_GROWABLE
+  t_keyword_bsave = register_function_0(basic_function_type_keyword, "BSAVE", do_bsave);
+  t_keyword_bload = register_function_0(basic_function_type_keyword, "BLOAD", do_bload);
+#endif
   // t_keyword_def = register_function_0(basic_function_type_keyword, "DEF", do_def_fn);
   // t_keyword_fn = register_token("FN");
  
@@ -2261,10 +3041,15 @@ void basic_init(size_t memory_size, size_t stack_size)
   // DEBUG
   register_function_0(basic_function_type_keyword, "DUMP", dump);
 
+#ifdef LINES_GROWABLE
+  if ( ! lines_init_growable(__program_size) )
+  {
+    error("CANNOT ALLOCATE PROGRAM SPACE");
+  }
+#else
   lines_init(__memory, __program_size);
+#endif
   variables_init();
-  __data.line = 0;
-  __data.cursor = 0;
   __data.state = data_state_init;
 
   arch_init();
@@ -2289,30 +3074,25 @@ void
 basic_eval(char *line)
 {
 
-  if(strlen(line) > 0 && (strlen(line)-1)>tokenizer_string_length)
-  {
-    error("LINE TOO LONG");
-    return;
-  }
-
-  char line_string[tokenizer_string_length];
-  strncpy(line_string, line, sizeof(line_string));
+  arena_mark mark = arena_get_mark(__scratch);
+  char* line_string = arena_strndup(__scratch, line, strlen(line));
   _trim(line_string);
   if(is_empty(line_string) || is_comment(line_string)){
+    arena_reset(__scratch, mark);
     return;
   }
 
   last_error = NULL;
-  tokenizer_init( line_string );
+  tokenizer_init(&__tokenizer, line_string );
   get_sym();
   if (sym == T_NUMBER ) {
-    float line_number = tokenizer_get_number();
-    char* line = tokenizer_char_pointer(NULL);
+    basic_number line_number = tokenizer_get_number(&__tokenizer);
+    char* line = tokenizer_char_pointer(&__tokenizer, NULL);
     get_sym();
     if (sym == T_EOF) {
       lines_delete( line_number );
     } else {
-      lines_store( line_number, line);
+      _store_line( line_number, line);
     }
   } else {
       __EVALUATING = true;
@@ -2325,23 +3105,24 @@ basic_eval(char *line)
               __EVALUATING = false;
       }
   }
+  arena_reset(__scratch, mark);
   // printf("stack available: %" PRIu16 "\n", __stack_p);
   // printf("memory available: %" PRIu16 "\n", lines_memory_available() );
 }
 
-float evaluate(char *expression_string)
+basic_number evaluate(char *expression_string)
 {
   last_error = NULL;
-  tokenizer_init( expression_string );
+  tokenizer_init(&__tokenizer, expression_string );
   get_sym();
-  float result =  numeric_expression();
+  basic_number result =  numeric_expression();
   expect(T_EOF);
   return result;
 }
 
 void evaluate_print(char *line)
 {
-  float result = evaluate(line); 
+  basic_number result = evaluate(line); 
   printf("%s = %f\n", line, result);
 }
 
@@ -2509,13 +3290,27 @@ get_parameter(kind k, basic_type* v)
   v->mallocd = false;
   if (k == kind_string)
   {
-    char *s = string_expression();
+    string_value s;
+    if ( ! string_expression(&s) )
+    {
+      string_borrow(&s, "");
+    }
+    // Extensions expect a zero terminated string
+    if ( ! s.mallocd && s.slice.string[s.slice.length] != '\0' )
+    {
+      char* copy = malloc(s.slice.length + 1);
+      memcpy(copy, s.slice.string, s.slice.length);
+      copy[s.slice.length] = '\0';
+      s.slice.string = copy;
+      s.mallocd = true;
+    }
     v->kind = kind_string;
-    v->value.string = s;
+    v->value.string = s.slice.string;
+    v->mallocd = s.mallocd;
   }
   else
   {
-    float n = numeric_expression();
+    basic_number n = numeric_expression();
     v->kind = kind_numeric;
     v->value.number = n;
   }
@@ -2603,7 +3398,7 @@ basic_dispatch_function(basic_function* function, basic_type* rv)
   }
 
   for(int i=0; i<function->nr_arguments; i++){
-    if(v[i].kind == kind_string){
+    if(v[i].kind == kind_string && v[i].mallocd){
        free(v[i].value.string);
     }
   }
@@ -2649,11 +3444,11 @@ str_str(basic_type* number, basic_type* rv)
   return 0;
 }
 
-void dump_var(variable* var, void* context)
+void dump_var(char* name, variable* var, void* context)
 {
 #ifndef _WIN32
 #if ARCH!=ARCH_XMEGA  
-  variable_dump(var);
+  variable_dump(name, var);
 #endif
 #endif
 }
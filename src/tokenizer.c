@@ -1,17 +1,34 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <float.h>
 
 #include "arch.h"
 #include "tokenizer.h"
 #include "hexdump.h"
 #include "array.h"
+#include "usingwin.h"
 
 static array* token_array = NULL;
 
+#ifndef _WIN32
+#  if ARCH!=ARCH_XMEGA
+#    define TOKENIZER_CACHE
+#  endif
+#else
+#  define TOKENIZER_CACHE
+#endif
+
+#ifdef TOKENIZER_CACHE
+static bool _cache_replay(tokenizer_state* state, token* t);
+static void _cache_seek(tokenizer_state* state, char* p);
+#endif
+
 add_token( T_ERROR, NULL );
 add_token( T_EOF, NULL );
 add_token( T_NUMBER, NULL );
@@ -31,16 +48,6 @@ add_token( T_LESS, "<" );
 add_token( T_GREATER, ">" );
 add_token( T_COMMA, "," );
 
-char *tokenizer_line = NULL;
-char *tokenizer_p = NULL;
-char *tokenizer_next_p = NULL;
-
-token tokenizer_actual_token;
-float tokenizer_actual_number;
-char tokenizer_actual_char;
-char tokenizer_actual_string[tokenizer_string_length];
-char tokenizer_actual_variable[tokenizer_variable_length];
-
 void tokenizer_setup(void)
 {
   token_array = array_new(sizeof(token_entry));
@@ -64,25 +71,47 @@ void tokenizer_setup(void)
   tokenizer_register_token( &_T_COMMA);
 }
 
-void tokenizer_init(char *input)
+void tokenizer_init(tokenizer_state* state, char *input)
+{
+  state->line = input;
+  state->p = state->next_p = state->line;
+  state->cached = NULL;
+  state->crunched = false;
+}
+
+void tokenizer_init_crunched(tokenizer_state* state, char *input)
 {
-  tokenizer_line = input;
-  tokenizer_p = tokenizer_next_p = tokenizer_line;
+  tokenizer_init(state, input);
+  state->crunched = true;
 }
 
-char* tokenizer_char_pointer(char* set)
+tokenizer_position tokenizer_get_position(tokenizer_state* state)
+{
+  tokenizer_position position;
+  position.line = state->line;
+  position.p = state->p;
+  position.cached = state->cached;
+  position.index = state->index;
+  position.crunched = state->crunched;
+  return position;
+}
+
+char* tokenizer_char_pointer(tokenizer_state* state, char* set)
 {
   if ( set != NULL )
   {
-    tokenizer_p = set; 
+    state->p = set; 
+#ifdef TOKENIZER_CACHE
+    _cache_seek(state, set);
+#endif
     return NULL;
   }
 
   // Skip white space
-  while ( *tokenizer_p && isspace(*tokenizer_p) ) {
-    tokenizer_p++;
+  while ( *state->p && isspace((unsigned char) *state->p) ) {
+    state->p++;
   } 
-  return tokenizer_p;
+  return state->p;
 }
 
 static bool
@@ -93,7 +122,7 @@ isvarchar(char c)
     return true;
   }
 
-  if ( c == '$' ) {
+  if ( c == '$' || c == '%' || c == '@' || c == '!' ) {
     return true;
   }
 
@@ -104,126 +133,486 @@ isvarchar(char c)
   return false;
 }
 
-token _find_registered(void)
+/*
+  Keywords are matched through a first character dispatch table. The
+  registered tokens are copied into keyword_array, sorted on their first
+  character and, within a bucket, on descending length. keyword_bucket[c]
+  holds the offset of the first keyword starting with character c, so a
+  lookup only compares the few keywords sharing the first character, and the
+  first match in a bucket is the longest one.
+
+  The table is rebuilt by tokenizer_register_token(), lookups only read it.
+*/
+
+#define keyword_first_char ' '
+#define keyword_last_char '~'
+#define keyword_buckets ( keyword_last_char - keyword_first_char + 1 )
+
+typedef struct {
+  token token;
+  token_name name;
+  uint8_t length;
+  uint8_t index;
+} keyword_entry;
+
+static array* keyword_array = NULL;
+static uint16_t keyword_bucket[keyword_buckets + 1];
+
+  static int
+_keyword_compare(const void* a, const void* b)
 {
+  const keyword_entry* ka = (const keyword_entry*) a;
+  const keyword_entry* kb = (const keyword_entry*) b;
+
+  if ( ka->name[0] != kb->name[0] )
+  {
+    return (unsigned char) ka->name[0] - (unsigned char) kb->name[0];
+  }
+  if ( ka->length != kb->length )
+  {
+    return kb->length - ka->length;
+  }
+  return ka->index - kb->index;
+}
 
-  // printf("_find registered\n");
+  static void
+_keyword_rebuild(void)
+{
+  if ( keyword_array != NULL )
+  {
+    array_destroy(keyword_array);
+  }
+  keyword_array = array_new(sizeof(keyword_entry));
 
   for(size_t i=0; i<array_size(token_array); i++)
   {
-    // token_entry* entry = registered_tokens_ptr + i * sizeof(token_entry);
     token_entry* entry = (token_entry*) array_get(token_array, i);
-  
-    // printf("t: '%s'\n", entry->name);
-
     if ( entry->name == NULL ) continue;
+    char first = entry->name[0];
+    if ( first < keyword_first_char || first > keyword_last_char ) continue;
 
-    // printf("look for: '%s', in '%s'\n", entry->name, tokenizer_p);
+    keyword_entry keyword = {
+      .token = entry->token,
+      .name = entry->name,
+      .length = strlen(entry->name),
+      .index = i
+    };
+    array_push(keyword_array, &keyword);
+  }
+
+  size_t count = array_size(keyword_array);
+  if ( count > 0 )
+  {
+    qsort(array_get(keyword_array, 0), count, sizeof(keyword_entry), _keyword_compare);
+  }
 
-    if (strncmp(tokenizer_p, entry->name, strlen(entry->name)) == 0) {
-       // printf("found '%s'\n", entry->name);
-       tokenizer_next_p = tokenizer_p + strlen(entry->name);
-       tokenizer_p = tokenizer_next_p;
-       return entry->token;
+  size_t k = 0;
+  for(size_t c=0; c<=keyword_buckets; c++)
+  {
+    while ( k < count && (size_t) (((keyword_entry*) array_get(keyword_array, k))->name[0] - keyword_first_char) < c )
+    {
+      k++;
+    }
+    keyword_bucket[c] = k;
+  }
+
+}
+
+token _find_registered(tokenizer_state* state)
+{
+  char first = *state->p;
+  if ( first < keyword_first_char || first > keyword_last_char )
+  {
+    return T_THE_END;
+  }
+
+  size_t c = first - keyword_first_char;
+  for(size_t i=keyword_bucket[c]; i<keyword_bucket[c+1]; i++)
+  {
+    keyword_entry* keyword = (keyword_entry*) array_get(keyword_array, i);
+
+    // First character already matches, check the rest
+    if ( strncmp(state->p + 1, keyword->name + 1, keyword->length - 1) == 0 )
+    {
+       state->next_p = state->p + keyword->length;
+       state->p = state->next_p;
+       state->keyword_index = keyword->index;
+       return keyword->token;
     }
   }
   return T_THE_END;
 }
 
-token tokenizer_get_next_token(void)
+/*
+  Numbers
+
+  A number is a run of digits and dots. It is converted in place, without
+  copying the run. Up to 19 significant digits are collected in an integer,
+  which is then scaled by an exactly representable power of ten. One exact
+  operand and one rounding gives a correctly rounded result. The few cases
+  that do not fit (very long mantissas, large exponents, results exactly
+  between two floats) are handed to strtof() or strtod().
+*/
+
+#define number_max_digits 19
+#define number_copy_length 48
+
+#ifdef BASIC_NUMBER_FLOAT
+static const float float_pow10[] = {
+  1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+#endif
+
+#if DBL_MANT_DIG >= 53
+static const double double_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#endif
+
+  static basic_number
+_slow_number(char* start, char* end)
+{
+  // strtof() would read an exponent or a hexadecimal prefix following the
+  // run, in that case it gets a copy.
+  if ( *end != 'E' && *end != 'e' && *end != 'X' && *end != 'x' )
+  {
+    return number_strto(start, NULL);
+  }
+
+  char copy[number_copy_length];
+  size_t len = end - start;
+  if ( len > sizeof(copy) - 1 )
+  {
+    len = sizeof(copy) - 1;
+  }
+  memcpy(copy, start, len);
+  copy[len] = '\0';
+  return number_strto(copy, NULL);
+}
+
+  static char*
+_scan_number(char* p, basic_number* number)
 {
-  if ( ! *tokenizer_p ) {
+  char* start = p;
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool truncated = false;
+  bool dot = false;
+
+  for(;; p++)
+  {
+    if ( *p >= '0' && *p <= '9' )
+    {
+      if ( digits < number_max_digits )
+      {
+        if ( mantissa || *p != '0' )
+        {
+          mantissa = mantissa * 10 + ( *p - '0' );
+          digits++;
+        }
+        if ( dot )
+        {
+          exponent--;
+        }
+      }
+      else
+      {
+        if ( *p != '0' )
+        {
+          truncated = true;
+        }
+        if ( ! dot )
+        {
+          exponent++;
+        }
+      }
+    }
+    else if ( *p == '.' && ! dot )
+    {
+      dot = true;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  // The rest of the run is ignored, like "1.2.3" reads as 1.2
+  char* end = p;
+  while ( ( *end >= '0' && *end <= '9' ) || *end == '.' )
+  {
+    end++;
+  }
+
+  if ( mantissa == 0 )
+  {
+    *number = 0;
+    return end;
+  }
+
+#ifdef BASIC_NUMBER_FLOAT
+  if ( ! truncated && mantissa <= ( 1UL << 24 ) && exponent >= -10 && exponent <= 10 )
+  {
+    float f = (float) mantissa;
+    *number = ( exponent < 0 ) ? f / float_pow10[-exponent] : f * float_pow10[exponent];
+    return end;
+  }
+
+#endif
+
+#if DBL_MANT_DIG >= 53
+  if ( ! truncated && mantissa <= ( 1ULL << 53 ) && exponent >= -22 && exponent <= 22 )
+  {
+    double d = (double) mantissa;
+    d = ( exponent < 0 ) ? d / double_pow10[-exponent] : d * double_pow10[exponent];
+#ifdef BASIC_NUMBER_DOUBLE
+    *number = d;
+    return end;
+#else
+    // Rounding the correctly rounded double to float is only off when the
+    // double lies exactly halfway between two floats.
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    uint64_t rest = bits & ( ( 1ULL << ( DBL_MANT_DIG - FLT_MANT_DIG ) ) - 1 );
+    if ( rest != ( 1ULL << ( DBL_MANT_DIG - FLT_MANT_DIG - 1 ) ) )
+    {
+      *number = (float) d;
+      return end;
+    }
+#endif
+  }
+#endif
+
+  *number = _slow_number(start, end);
+  return end;
+}
+
+/*
+  Crunched program lines
+
+  Program lines are stored with their keywords, numbers and variable names
+  replaced by compact byte codes. Everything else (white space, operators,
+  string literals, ...) is kept as plain text, so a crunched line is still
+  a NUL terminated string. Codes are only decoded from stored lines, text
+  typed in is read as it is.
+
+    0x80 + i        keyword, i is its index in the registered tokens
+    NUMBER  varint  number, the varints hold the bits of the number, one
+                    for every 32 bits
+    INTEGER varint  integral number in [0, 2^24)
+    VARIABLE varint variable name, the varint is its index in variable_names
+    LITERAL byte    a byte of plain text that would read as one of the codes,
+                    like the bytes of UTF-8 text outside a string literal
+
+  Everything after REM is kept as typed, only escaped where needed.
+
+  A varint is stored big endian in 6 bit groups; every group but the last
+  one has its two upper bits set (0xC0), the last one has 0x80. This keeps
+  the encoding free of NUL bytes.
+*/
+
+#define crunch_keyword 0x80
+#define crunch_keyword_max 0x7F
+#define crunch_number 0x01
+#define crunch_integer 0x02
+#define crunch_variable 0x03
+#define crunch_literal 0x04
+#define crunch_integer_limit 16777216UL
+#define number_words ( sizeof(basic_number) / sizeof(uint32_t) )
+
+static array* variable_names = NULL;
+
+  static char*
+_varint_put(char* out, char* out_end, uint32_t value)
+{
+  uint8_t groups[6];
+  size_t n = 0;
+  do
+  {
+    groups[n++] = value & 0x3F;
+    value >>= 6;
+  } while ( value );
+
+  if ( out + n > out_end )
+  {
+    return NULL;
+  }
+
+  while ( n > 1 )
+  {
+    *out++ = 0xC0 | groups[--n];
+  }
+  *out++ = 0x80 | groups[0];
+  return out;
+}
+
+  static char*
+_varint_get(char* in, uint32_t* value)
+{
+  uint32_t v = 0;
+  while ( ( (unsigned char) *in & 0xC0 ) == 0xC0 )
+  {
+    v = ( v << 6 ) | ( *in++ & 0x3F );
+  }
+  if ( ( (unsigned char) *in & 0xC0 ) == 0x80 )
+  {
+    v = ( v << 6 ) | ( *in++ & 0x3F );
+  }
+  *value = v;
+  return in;
+}
+
+  static char*
+_number_get(char* in, basic_number* number)
+{
+  uint32_t bits[number_words];
+  for(size_t i=0; i<number_words; i++)
+  {
+    in = _varint_get(in, &bits[i]);
+  }
+  memcpy(number, bits, sizeof(bits));
+  return in;
+}
+
+  static token
+_get_crunched(tokenizer_state* state)
+{
+  unsigned char c = *state->p;
+  uint32_t v;
+
+  if ( c >= crunch_keyword )
+  {
+    size_t index = c - crunch_keyword;
+    if ( index >= array_size(token_array) )
+    {
+      return T_ERROR;
+    }
+    state->p++;
+    state->keyword_index = index;
+    return ((token_entry*) array_get(token_array, index))->token;
+  }
+
+  switch ( c )
+  {
+    case crunch_integer:
+      state->p = _varint_get(state->p + 1, &v);
+      state->number = v;
+      return T_NUMBER;
+
+    case crunch_number:
+      state->p = _number_get(state->p + 1, &state->number);
+      return T_NUMBER;
+
+    case crunch_variable:
+      state->p = _varint_get(state->p + 1, &v);
+      if ( v >= array_size(variable_names) )
+      {
+        return T_ERROR;
+      }
+      {
+        char* name = *((char**) array_get(variable_names, v));
+        size_t len = strlen(name);
+        state->variable.string = name;
+        state->variable.length = len;
+        state->variable_index = v;
+        if ( name[len-1] == '$' )
+        {
+          return T_VARIABLE_STRING;
+        }
+        return T_VARIABLE_NUMBER;
+      }
+
+    case crunch_literal:
+      // Plain text where a token was expected, step over it
+      state->p++;
+      if ( *state->p )
+      {
+        state->p++;
+      }
+      return T_ERROR;
+
+    default:
+      break;
+  }
+
+  return T_THE_END;
+}
+
+token tokenizer_get_next_token(tokenizer_state* state)
+{
+#ifdef TOKENIZER_CACHE
+  token cached;
+  if ( _cache_replay(state, &cached) )
+  {
+    return cached;
+  }
+#endif
+
+  if ( ! *state->p ) {
     return T_EOF;
   } 
 
   // Skip white space
-  while ( *tokenizer_p && isspace(*tokenizer_p) ) {
-    tokenizer_p++;
+  while ( *state->p && isspace((unsigned char) *state->p) ) {
+    state->p++;
   } 
 
-  // Check for number
-  if (isdigit(*tokenizer_p) || *tokenizer_p == '.') {
-    // puts("read a number");
-    tokenizer_next_p = tokenizer_p;
-    size_t l=0;
-    while (*tokenizer_next_p && ( isdigit(*tokenizer_next_p) || *tokenizer_next_p == '.') ) {
-      l++;
-      tokenizer_next_p++;
-    }
-#ifdef _WIN32
-    char *number;
-    number = malloc(l + 1);
-#else
-    char number[l+1];
-#endif
-    memset(number, 0, l+1);
-    // strlcpy(number, tokenizer_p, sizeof(number) );
-    strncpy(number, tokenizer_p, l );
-    number[l] = '\0';
-    tokenizer_p = tokenizer_next_p;
-    float f;
-    // printf("[%s]\n", number);
-    sscanf(number, "%f", &f);
-    // printf("Got float: '%f'\n", f);
-    tokenizer_actual_number = f;
-
-#ifdef _WIN32
-    free(number);
-#endif
+  // Check for crunched tokens
+  token t;
+  if ( state->crunched && ( t = _get_crunched(state) ) != T_THE_END )
+  {
+    return t;
+  }
 
+  // Check for number
+  if (isdigit((unsigned char) *state->p) || *state->p == '.') {
+    state->next_p = _scan_number(state->p, &state->number);
+    state->p = state->next_p;
     return T_NUMBER;
   }
 
   // Check for string
-  if ( '"' == *tokenizer_p ) {
+  if ( '"' == *state->p ) {
     // puts("read string");
-    tokenizer_p++; // skip "
-    tokenizer_next_p = tokenizer_p;
-    size_t l=0;
-    while(*tokenizer_next_p && '"' != *tokenizer_next_p) {
-      l++;
-      tokenizer_next_p++;
+    state->p++; // skip "
+    state->next_p = strchr(state->p, '"');
+    if (state->next_p == NULL) {
+      state->next_p = state->p + strlen(state->p);
     }
+    state->string.string = state->p;
+    state->string.length = state->next_p - state->p;
 
-    if (*tokenizer_next_p) {
-      tokenizer_next_p++; // skip trailing "
+    if (*state->next_p) {
+      state->next_p++; // skip trailing "
     }
 
-    if(l>80){
-      return T_ERROR;
-    }
-
-    memcpy(tokenizer_actual_string, tokenizer_p, l);
-    tokenizer_actual_string[l] = '\0';
-   
-    tokenizer_p = tokenizer_next_p;
+    state->p = state->next_p;
 
     return T_STRING; 
   }
 
-  token t = _find_registered();
+  t = _find_registered(state);
   if ( t != T_THE_END )
   {
     return t;
   }
 
   // Check for variable
-  tokenizer_next_p = tokenizer_p;
+  state->next_p = state->p;
   size_t len = 0;
-  while(*tokenizer_next_p && isvarchar(*tokenizer_next_p)) {
+  while(*state->next_p && isvarchar(*state->next_p)) {
     len++;
-    tokenizer_next_p++;
-  }
-
-  if(len>tokenizer_variable_length){
-    return T_ERROR;
+    state->next_p++;
   }
 
   if (len > 0) {
-    memcpy(tokenizer_actual_variable, tokenizer_p, len);
-    tokenizer_actual_variable[len] = '\0';
-    tokenizer_p = tokenizer_next_p;
-    if (tokenizer_actual_variable[len-1] == '$') {
+    state->variable.string = state->p;
+    state->variable.length = len;
+    state->variable_index = TOKENIZER_NOT_INTERNED;
+    state->p = state->next_p;
+    if (state->p[-1] == '$') {
       return T_VARIABLE_STRING;
     }
     return T_VARIABLE_NUMBER;
@@ -232,19 +621,342 @@ token tokenizer_get_next_token(void)
   return T_ERROR; 
 }
 
-float tokenizer_get_number(void)
+basic_number tokenizer_get_number(tokenizer_state* state)
+{
+  return state->number;
+}
+
+slice tokenizer_get_string(tokenizer_state* state)
 {
-  return tokenizer_actual_number;
+  return state->string;
 }
 
-char *tokenizer_get_string(void)
+slice tokenizer_get_variable_name(tokenizer_state* state)
 {
-  return tokenizer_actual_string;
+  return state->variable;
+}
+
+size_t tokenizer_get_variable_index(tokenizer_state* state)
+{
+  return state->variable_index;
+}
+
+  static size_t
+_intern_variable(slice name)
+{
+  if ( variable_names == NULL )
+  {
+    variable_names = array_new(sizeof(char*));
+  }
+
+  for(size_t i=0; i<array_size(variable_names); i++)
+  {
+    char* interned = *((char**) array_get(variable_names, i));
+    if ( strncmp(interned, name.string, name.length) == 0 && interned[name.length] == '\0' )
+    {
+      return i;
+    }
+  }
+
+  char* copy = malloc(name.length + 1);
+  memcpy(copy, name.string, name.length);
+  copy[name.length] = '\0';
+  array_push(variable_names, &copy);
+  return array_size(variable_names) - 1;
+}
+
+  static char*
+_crunch_number(char* out, char* out_end, basic_number number)
+{
+  if ( number >= 0 && number < crunch_integer_limit && number == (uint32_t) number )
+  {
+    *out++ = crunch_integer;
+    return _varint_put(out, out_end, (uint32_t) number);
+  }
+
+  uint32_t bits[number_words];
+  memcpy(bits, &number, sizeof(bits));
+  *out++ = crunch_number;
+  for(size_t i=0; out && i<number_words; i++)
+  {
+    out = _varint_put(out, out_end, bits[i]);
+  }
+  return out;
+}
+
+  static char*
+_copy(char* out, char* out_end, char* from, char* to)
+{
+  size_t len = to - from;
+  if ( out + len > out_end )
+  {
+    return NULL;
+  }
+  memcpy(out, from, len);
+  return out + len;
 }
 
-void tokenizer_get_variable_name(char *name)
+  static bool
+_is_code(unsigned char c)
 {
-  strncpy(name, tokenizer_actual_variable, sizeof(tokenizer_actual_variable));
+  return c >= crunch_keyword || ( c >= crunch_number && c <= crunch_literal );
+}
+
+/*
+  Copy plain text, escaping the bytes that would read as codes. String
+  literals are read as they are, their bytes are copied unchanged.
+*/
+  static char*
+_copy_text(char* out, char* out_end, char* from, char* to)
+{
+  bool in_string = false;
+  for(char* p=from; p<to; p++)
+  {
+    unsigned char c = *p;
+    if ( c == '"' )
+    {
+      in_string = ! in_string;
+    }
+    bool escape = ! in_string && _is_code(c);
+    if ( out + ( escape ? 2 : 1 ) > out_end )
+    {
+      return NULL;
+    }
+    if ( escape )
+    {
+      *out++ = crunch_literal;
+    }
+    *out++ = c;
+  }
+  return out;
+}
+
+  static bool
+_is_rem(size_t keyword_index)
+{
+  return strcmp(((token_entry*) array_get(token_array, keyword_index))->name, "REM") == 0;
+}
+
+  bool
+tokenizer_crunch(char* input, char* output, size_t output_size)
+{
+  tokenizer_state crunch_state;
+  tokenizer_state* state = &crunch_state;
+
+  char* out = output;
+  char* out_end = output + output_size - 1;
+
+  tokenizer_init(state, input);
+  while ( out )
+  {
+    char* start = state->p;
+    while ( *state->p && isspace((unsigned char) *state->p) )
+    {
+      state->p++;
+    }
+    out = _copy(out, out_end, start, state->p);
+    if ( ! out )
+    {
+      break;
+    }
+
+    start = state->p;
+    token t = tokenizer_get_next_token(state);
+    if ( t == T_EOF )
+    {
+      break;
+    }
+
+    if ( t == T_ERROR )
+    {
+      // A character that is no token is kept as is, lexing goes on after it
+      state->p = start + 1;
+      out = _copy_text(out, out_end, start, state->p);
+      continue;
+    }
+
+    if ( out + 1 > out_end )
+    {
+      out = NULL;
+      break;
+    }
+
+    size_t len = state->p - start;
+    if ( t == T_NUMBER )
+    {
+      out = _crunch_number(out, out_end, state->number);
+    }
+    else if ( t == T_VARIABLE_NUMBER || t == T_VARIABLE_STRING )
+    {
+      *out++ = crunch_variable;
+      out = _varint_put(out, out_end, _intern_variable(state->variable));
+    }
+    else if ( t > T_VARIABLE_NUMBER && len > 1 && state->keyword_index < crunch_keyword_max )
+    {
+      *out++ = crunch_keyword + state->keyword_index;
+    }
+    else
+    {
+      out = _copy(out, out_end, start, state->p);
+    }
+
+    if ( out && t > T_VARIABLE_NUMBER && _is_rem(state->keyword_index) )
+    {
+      out = _copy_text(out, out_end, state->p, state->p + strlen(state->p));
+      break;
+    }
+  }
+
+  if ( out )
+  {
+    *out = '\0';
+  }
+
+  return out != NULL;
+}
+
+  static size_t
+_expand_number(char* out, size_t size, basic_number number)
+{
+  // Use the shortest representation that reads back as the same number
+  for(int precision=6; precision<NUMBER_DIGITS; precision++)
+  {
+    snprintf(out, size, "%.*g", precision, number);
+    if ( number_strto(out, NULL) == number )
+    {
+      return strlen(out);
+    }
+  }
+  snprintf(out, size, "%.*g", NUMBER_DIGITS, number);
+  return strlen(out);
+}
+
+  bool
+tokenizer_expand(char* input, char* output, size_t output_size)
+{
+  char* out = output;
+  char* out_end = output + output_size - 1;
+  bool in_string = false;
+  char number[32];
+
+  while ( *input )
+  {
+    unsigned char c = *input;
+    char* from = number;
+    size_t len = 0;
+    uint32_t v;
+
+    if ( in_string || c < crunch_keyword )
+    {
+      switch ( in_string ? 0 : c )
+      {
+        case crunch_integer:
+          input = _varint_get(input + 1, &v);
+          len = snprintf(number, sizeof(number), "%lu", (unsigned long) v);
+          break;
+        case crunch_number:
+          {
+            basic_number n;
+            input = _number_get(input + 1, &n);
+            len = _expand_number(number, sizeof(number), n);
+          }
+          break;
+        case crunch_variable:
+          input = _varint_get(input + 1, &v);
+          if ( v < array_size(variable_names) )
+          {
+            from = *((char**) array_get(variable_names, v));
+            len = strlen(from);
+          }
+          break;
+        case crunch_literal:
+          input++;
+          if ( *input )
+          {
+            from = input++;
+            len = 1;
+          }
+          break;
+        default:
+          if ( c == '"' )
+          {
+            in_string = ! in_string;
+          }
+          from = input++;
+          len = 1;
+          break;
+      }
+    }
+    else if ( c - crunch_keyword < array_size(token_array) )
+    {
+      input++;
+      from = ((token_entry*) array_get(token_array, c - crunch_keyword))->name;
+      len = strlen(from);
+    }
+    else
+    {
+      // Not a code this tokenizer writes, keep the byte
+      from = input++;
+      len = 1;
+    }
+
+    if ( out + len > out_end )
+    {
+      *out = '\0';
+      return false;
+    }
+    memcpy(out, from, len);
+    out += len;
+  }
+
+  *out = '\0';
+  return true;
+}
+
+  void
+tokenizer_clear_variables(void)
+{
+  if ( variable_names == NULL )
+  {
+    return;
+  }
+  for(size_t i=0; i<array_size(variable_names); i++)
+  {
+    free(*((char**) array_get(variable_names, i)));
+  }
+  array_destroy(variable_names);
+  variable_names = NULL;
+  // Cached lines refer to the interned names
+  tokenizer_cache_clear();
+}
+
+  char*
+tokenizer_variable_name(size_t index)
+{
+  if ( variable_names == NULL || index >= array_size(variable_names) )
+  {
+    return NULL;
+  }
+  return *((char**) array_get(variable_names, index));
+}
+
+  size_t
+tokenizer_intern_variable(char* name)
+{
+  slice s;
+  s.string = name;
+  s.length = strlen(name);
+  return _intern_variable(s);
+}
+
+  char*
+tokenizer_crunched_keyword(size_t index)
+{
+  if ( index >= crunch_keyword_max || index >= array_size(token_array) )
+  {
+    return NULL;
+  }
+  return ((token_entry*) array_get(token_array, index))->name;
 }
 
   void
@@ -262,12 +974,19 @@ tokenizer_register_token( token_entry* entry )
   // hexdump("tokens", new, sizeof(token_entry) * registered_tokens_count );
   */
   array_push(token_array, entry);
+  _keyword_rebuild();
 }
 
   void
 tokenizer_free_registered_tokens(void)
 {
   array_destroy(token_array);
+  if ( keyword_array != NULL )
+  {
+    array_destroy(keyword_array);
+    keyword_array = NULL;
+  }
+  tokenizer_clear_variables();
   /*
   registered_tokens_count = 0;
   free(registered_tokens_ptr);
@@ -275,3 +994,296 @@ tokenizer_free_registered_tokens(void)
   */
 }
 
+
+/*
+  Token cache
+
+  Executing a program line lexes it over and over again, for every pass
+  through a loop body or a subroutine. The cache keeps the decoded token
+  stream of the most recently used program lines: the tokens with their
+  number, string or variable name, and where they start and end in the
+  line. A tokenizer bound to a cached line replays those tokens instead of
+  lexing them.
+
+  The tokens point into the program memory, which moves when lines are
+  stored or deleted. The cache is dropped as a whole when the generation
+  passed in differs from the one it was filled with.
+*/
+
+#ifdef TOKENIZER_CACHE
+
+#define TOKENIZER_CACHE_LINES 16
+
+typedef struct
+{
+  token token;
+  char* start;
+  char* end;
+  union
+  {
+    basic_number number;
+    slice string;
+    struct
+    {
+      slice name;
+      size_t index;
+    } variable;
+  } value;
+} cached_token;
+
+struct tokenizer_line
+{
+  uint16_t number;
+  uint32_t used;
+  size_t count;
+  size_t capacity;
+  cached_token* tokens;
+};
+
+static tokenizer_line token_cache[TOKENIZER_CACHE_LINES];
+static uint32_t token_cache_generation = 0;
+static uint32_t token_cache_clock = 0;
+
+  static void
+_cache_bind(tokenizer_state* state, tokenizer_line* line)
+{
+  line->used = ++token_cache_clock;
+  state->cached = line;
+  state->crunched = true;
+  state->index = 0;
+  state->line = state->p = state->next_p = line->tokens[0].start;
+}
+
+  static void
+_cache_check_generation(uint32_t generation)
+{
+  if ( generation != token_cache_generation )
+  {
+    for(size_t i=0; i<TOKENIZER_CACHE_LINES; i++)
+    {
+      token_cache[i].count = 0;
+    }
+    token_cache_generation = generation;
+  }
+}
+
+  static bool
+_cache_replay(tokenizer_state* state, token* t)
+{
+  tokenizer_line* line = state->cached;
+  if ( line == NULL )
+  {
+    return false;
+  }
+  if ( state->index >= line->count )
+  {
+    // Past the recorded tokens, lex from here
+    state->cached = NULL;
+    return false;
+  }
+
+  cached_token* cached = &line->tokens[state->index++];
+  state->p = state->next_p = cached->end;
+  switch ( cached->token )
+  {
+    case T_NUMBER:
+      state->number = cached->value.number;
+      break;
+    case T_STRING:
+      state->string = cached->value.string;
+      break;
+    case T_VARIABLE_NUMBER:
+    case T_VARIABLE_STRING:
+      state->variable = cached->value.variable.name;
+      state->variable_index = cached->value.variable.index;
+      break;
+    default:
+      break;
+  }
+  *t = cached->token;
+  return true;
+}
+
+/*
+  Move a bound tokenizer to the first token at or after p, used when the
+  parser jumps to a saved cursor. A cursor outside the line unbinds it.
+*/
+  static void
+_cache_seek(tokenizer_state* state, char* p)
+{
+  tokenizer_line* line = state->cached;
+  if ( line == NULL )
+  {
+    return;
+  }
+
+  if ( line->count == 0 || p < line->tokens[0].start || p > line->tokens[line->count-1].end )
+  {
+    state->cached = NULL;
+    return;
+  }
+
+  size_t low = 0;
+  size_t high = line->count;
+  while ( low < high )
+  {
+    size_t mid = low + (high - low) / 2;
+    if ( line->tokens[mid].start < p )
+    {
+      low = mid + 1;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  state->index = low;
+}
+
+  bool
+tokenizer_cache_lookup(tokenizer_state* state, uint16_t number, uint32_t generation)
+{
+  _cache_check_generation(generation);
+  for(size_t i=0; i<TOKENIZER_CACHE_LINES; i++)
+  {
+    tokenizer_line* line = &token_cache[i];
+    if ( line->count > 0 && line->number == number )
+    {
+      _cache_bind(state, line);
+      return true;
+    }
+  }
+  return false;
+}
+
+  void
+tokenizer_cache_store(tokenizer_state* state, uint16_t number, char* contents, uint32_t generation)
+{
+  if ( contents == NULL )
+  {
+    return;
+  }
+
+  _cache_check_generation(generation);
+
+  // Reuse the least recently used slot
+  tokenizer_line* line = &token_cache[0];
+  for(size_t i=1; i<TOKENIZER_CACHE_LINES && line->count > 0; i++)
+  {
+    if ( token_cache[i].count == 0 || token_cache[i].used < line->used )
+    {
+      line = &token_cache[i];
+    }
+  }
+
+  line->number = number;
+  line->count = 0;
+
+  tokenizer_state decode;
+  tokenizer_init_crunched(&decode, contents);
+  token t;
+  do
+  {
+    if ( line->count == line->capacity )
+    {
+      line->capacity = line->capacity ? line->capacity * 2 : 16;
+      line->tokens = realloc(line->tokens, line->capacity * sizeof(cached_token));
+    }
+    cached_token* cached = &line->tokens[line->count++];
+    cached->start = tokenizer_char_pointer(&decode, NULL);
+    t = tokenizer_get_next_token(&decode);
+    cached->token = t;
+    cached->end = decode.p;
+    switch ( t )
+    {
+      case T_NUMBER:
+        cached->value.number = decode.number;
+        break;
+      case T_STRING:
+        cached->value.string = decode.string;
+        break;
+      case T_VARIABLE_NUMBER:
+      case T_VARIABLE_STRING:
+        cached->value.variable.name = decode.variable;
+        cached->value.variable.index = decode.variable_index;
+        break;
+      default:
+        break;
+    }
+  }
+  while ( t != T_EOF && t != T_ERROR );
+
+  _cache_bind(state, line);
+}
+
+  void
+tokenizer_cache_clear(void)
+{
+  for(size_t i=0; i<TOKENIZER_CACHE_LINES; i++)
+  {
+    free(token_cache[i].tokens);
+    token_cache[i].tokens = NULL;
+    token_cache[i].count = 0;
+    token_cache[i].capacity = 0;
+  }
+}
+
+/*
+  A position replaying a cached line is only good while its slot still
+  holds that line, the slot may have been reused since.
+*/
+  bool
+tokenizer_set_position(tokenizer_state* state, tokenizer_position* position, uint32_t generation)
+{
+  tokenizer_line* line = position->cached;
+  if ( line != NULL )
+  {
+    if ( generation != token_cache_generation
+      || line->count == 0
+      || line->tokens[0].start != position->line )
+    {
+      return false;
+    }
+    line->used = ++token_cache_clock;
+  }
+  state->line = position->line;
+  state->p = state->next_p = position->p;
+  state->cached = line;
+  state->index = position->index;
+  state->crunched = position->crunched;
+  return true;
+}
+
+#else
+
+  bool
+tokenizer_set_position(tokenizer_state* state, tokenizer_position* position, uint32_t generation)
+{
+  state->line = position->line;
+  state->p = state->next_p = position->p;
+  state->crunched = position->crunched;
+  return true;
+}
+
+  bool
+tokenizer_cache_lookup(tokenizer_state* state, uint16_t number, uint32_t generation)
+{
+  return false;
+}
+
+  void
+tokenizer_cache_store(tokenizer_state* state, uint16_t number, char* contents, uint32_t generation)
+{
+  if ( contents != NULL )
+  {
+    tokenizer_char_pointer(state, contents);
+    state->crunched = true;
+  }
+}
+
+  void
+tokenizer_cache_clear(void)
+{
+}
+
+#endif
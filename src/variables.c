@@ -2,66 +2,354 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
 #include <error.h>
 #include <variables.h>
 #include <dictionary.h>
+#include <arena.h>
 #include <array.h>
 
 #include "usingwin.h"
 
 typedef union
 {
-  float num;
+  basic_number num;
+  int32_t integer;
   char *string;
 } variable_value;
 
+/*
+  A scalar is no more than its value and type, 16 bytes on a 64 bit host.
+  Scalars come from a pool of their own, so the variables a program uses
+  sit next to each other. An array starts with the same header, followed
+  by its shape and elements. Names are only kept by the dictionary.
+*/
 struct variable
 {
-  char *name;
-  variable_type type;
   variable_value value;
+  uint8_t type;
   bool is_array;
+};
+
+typedef struct
+{
+  variable header;
   size_t nr_dimensions;
   size_t dimensions[5];
-  array* array;
-};
+  size_t strides[5];
+  size_t size;
+  void* elements;
+} array_variable;
 
 dictionary *_dictionary = NULL;
 
+/*
+  Symbol table of the program: the variables bound to the slot of their
+  name, the index the tokenizer interned it at. A slot is bound on its
+  first use, after that the variable is a load from the table instead of
+  a dictionary lookup. Scalars and arrays share a name but not a variable.
+*/
+typedef struct
+{
+  variable* scalar;
+  variable* array;
+} variable_slot;
+
+static variable_slot* _slots = NULL;
+static size_t _slots_size = 0;
+
+/*
+  Variables and their names are allocated from pools, CLEAR and NEW give
+  them back at once by resetting it. Only the values, strings and array
+  elements, live on the heap.
+*/
+#if ARCH!=ARCH_XMEGA
+#  define POOL_CHUNK_SIZE 4096
+#else
+#  define POOL_CHUNK_SIZE 256
+#endif
+
+static arena* _pool = NULL;
+static arena_mark _pool_empty;
+static arena* _scalars = NULL;
+static arena_mark _scalars_empty;
+
 const char* E_INDEX_OUT_OF_BOUNDS = "INDEX OUT OF BOUNDS";
 const char* E_VAR_NOT_FOUND = "VAR NOT FOUND";
+const char* E_OVERFLOW = "OVERFLOW";
 
 #if ARCH!=ARCH_XMEGA
 static void vector_print(size_t* vector, size_t dimensions);
 #endif
 
+  static char*
+_copy_slice(slice value)
+{
+  char* copy = malloc(value.length + 1);
+  memcpy(copy, value.string, value.length);
+  copy[value.length] = '\0';
+  return copy;
+}
+
 bool
 variables_init(void)
 {
-  _dictionary = dictionary_new();
+  _pool = arena_new(POOL_CHUNK_SIZE);
+  _scalars = arena_new(POOL_CHUNK_SIZE);
+  if (_pool == NULL || _scalars == NULL)
+  {
+    return false;
+  }
+  _pool_empty = arena_get_mark(_pool);
+  _scalars_empty = arena_get_mark(_scalars);
+  _dictionary = dictionary_new_in(_pool);
   return _dictionary != NULL;
 }
 
+  static void
+_free_values(variable* var)
+{
+  if(var->is_array){
+    array_variable* a = (array_variable*) var;
+    if(var->type == variable_type_string){
+      for(size_t i=0; i<a->size; i++){
+        free(((char**) a->elements)[i]);
+      }
+    }
+    free(a->elements); 
+  } else if(var->type == variable_type_string){
+    if(var->value.string!=NULL) free(var->value.string);
+  }
+}
 
 static void
 cb(char* name, void* value, void* context)
 {
-  variable *var = (variable *) value;
-  if(var->type == variable_type_string){
-    if(var->value.string!=NULL) free(var->value.string);
-  }
-  if(var->is_array){
-    array_destroy(var->array); 
-  }
-  if(var->name!=NULL) free(var->name);
-  free(var);
+  _free_values((variable *) value);
 }
 
 void
 variables_destroy(void)
 {
+  variables_unbind();
   dictionary_destroy(_dictionary, cb);
+  arena_destroy(_pool);
+  arena_destroy(_scalars);
+}
+
+void
+variables_clear(void)
+{
+  variables_unbind();
+  dictionary_clear(_dictionary, cb);
+  arena_reset(_pool, _pool_empty);
+  arena_reset(_scalars, _scalars_empty);
+}
+
+  static variable*
+_scalar_new(variable_type type)
+{
+  variable* var = arena_alloc(_scalars, sizeof(variable));
+  if (var == NULL)
+  {
+    return NULL;
+  }
+  var->value.string = NULL;
+  var->type = type;
+  var->is_array = false;
+  return var;
+}
+
+void
+variables_unbind(void)
+{
+  free(_slots);
+  _slots = NULL;
+  _slots_size = 0;
+}
+
+  static bool
+_slots_reserve(size_t slot)
+{
+  if ( slot < _slots_size )
+  {
+    return true;
+  }
+  size_t size = _slots_size ? _slots_size : 16;
+  while ( size <= slot )
+  {
+    size *= 2;
+  }
+  variable_slot* slots = realloc(_slots, size * sizeof(variable_slot));
+  if ( slots == NULL )
+  {
+    return false;
+  }
+  memset(&slots[_slots_size], 0, (size - _slots_size) * sizeof(variable_slot));
+  _slots = slots;
+  _slots_size = size;
+  return true;
+}
+
+  static variable*
+_lookup(slice name, bool is_array)
+{
+  // Array names carry the '(' in the dictionary
+  char buffer[32];
+  size_t size = name.length + ( is_array ? 2 : 1 );
+  char* key = size <= sizeof(buffer) ? buffer : malloc(size);
+  if ( key == NULL )
+  {
+    return NULL;
+  }
+  memcpy(key, name.string, name.length);
+  if ( is_array )
+  {
+    key[name.length] = '(';
+  }
+  key[size-1] = '\0';
+
+  variable* var = dictionary_get(_dictionary, key);
+  if ( var == NULL && ! is_array )
+  {
+    slice empty = { "", 0 };
+    var = ( name.length > 0 && name.string[name.length-1] == '$' )
+      ? variable_set_string(key, empty)
+      : variable_set_numeric(key, 0);
+  }
+
+  if ( key != buffer )
+  {
+    free(key);
+  }
+  return var;
+}
+
+  variable*
+variable_bind(size_t slot, slice name, bool is_array)
+{
+  if ( slot < _slots_size )
+  {
+    variable* var = is_array ? _slots[slot].array : _slots[slot].scalar;
+    if ( var != NULL )
+    {
+      return var;
+    }
+  }
+
+  variable* var = _lookup(name, is_array);
+  if ( var != NULL && slot != VARIABLE_NO_SLOT && _slots_reserve(slot) )
+  {
+    if ( is_array )
+    {
+      _slots[slot].array = var;
+    }
+    else
+    {
+      _slots[slot].scalar = var;
+    }
+  }
+  return var;
+}
+
+  variable_type
+variable_name_type(slice name)
+{
+  switch (name.length > 0 ? name.string[name.length-1] : '\0')
+  {
+    case '$':
+      return variable_type_string;
+    case '%':
+      return variable_type_integer;
+    case '@':
+      return variable_type_byte;
+    case '!':
+      return variable_type_bit;
+    default:
+      return variable_type_numeric;
+  }
+}
+
+  int32_t
+variable_float_to_integer(basic_number value)
+{
+  // Truncated like INT, anything out of range is an error
+  if ( ! ( value >= -2147483648.0f && value < 2147483648.0f ) )
+  {
+    error(E_OVERFLOW);
+    return 0;
+  }
+  return (int32_t) value;
+}
+
+  basic_number
+variable_numeric(variable* var)
+{
+  if (var->type == variable_type_integer)
+  {
+    return var->value.integer;
+  }
+  return var->value.num;
+}
+
+  void
+variable_store_numeric(variable* var, basic_number value)
+{
+  if (var->type == variable_type_integer)
+  {
+    var->value.integer = variable_float_to_integer(value);
+    return;
+  }
+  var->value.num = value;
+}
+
+  int32_t
+variable_integer(variable* var)
+{
+  if (var->type == variable_type_integer)
+  {
+    return var->value.integer;
+  }
+  return variable_float_to_integer(var->value.num);
+}
+
+  void
+variable_store_integer(variable* var, int32_t value)
+{
+  if (var->type == variable_type_integer)
+  {
+    var->value.integer = value;
+    return;
+  }
+  var->value.num = value;
+}
+
+  int32_t*
+variable_integer_storage(variable* var)
+{
+  return &var->value.integer;
+}
+
+  basic_number*
+variable_numeric_storage(variable* var)
+{
+  return &var->value.num;
+}
+
+  char*
+variable_string(variable* var)
+{
+  return var->value.string;
+}
+
+  void
+variable_store_string(variable* var, slice value)
+{
+  // The value can be a view on the actual value, copy it first
+  char* copy = _copy_slice(value);
+  free(var->value.string);
+  var->value.string = copy;
 }
 
 variable*
@@ -76,12 +364,13 @@ variable_get_string(char* name)
   // printf("Var name: '%s'\n", name);
   variable *var = dictionary_get(_dictionary, name);
   if(!var){
-    var = variable_set_string(name, "");
+    slice empty = { "", 0 };
+    var = variable_set_string(name, empty);
   }
   return var->value.string;
 }
 
-float
+basic_number
 variable_get_numeric(char* name)
 {
   // printf("Var name: '%s'\n", name);
@@ -89,41 +378,44 @@ variable_get_numeric(char* name)
   if(!var){
     var = variable_set_numeric(name, 0);
   }
-  return var->value.num;
+  return variable_numeric(var);
 }
 
 variable*
-variable_set_string(char* name, char* value)
+variable_set_string(char* name, slice value)
 {
-  // printf("set var '%s' to '%s'\n", name, value); 
+  // The value can be a view on the actual value, copy it first
+  char* copy = _copy_slice(value);
   variable *var = dictionary_get(_dictionary, name);
   if(var==NULL){
-    var = (variable*) malloc(sizeof(variable));
-    var->name = C_STRDUP(name);
-    var->type = variable_type_string;
-    var->is_array = false;
+    var = _scalar_new(variable_type_string);
+    if(var==NULL){
+      free(copy);
+      return NULL;
+    }
   } else {
     if(var->value.string!=NULL){
       free(var->value.string);
     }
   }
-  var->value.string = C_STRDUP(value);
+  var->value.string = copy;
   dictionary_put(_dictionary, name, var);
   return var;
 }
 
 variable*
-variable_set_numeric(char* name, float value)
+variable_set_numeric(char* name, basic_number value)
 {
   // printf("set var '%s' to %f\n", name, value); 
   variable *var = dictionary_get(_dictionary, name);
   if(var==NULL){
-    var = (variable*) malloc(sizeof(variable));
-    var->name = C_STRDUP(name);
-    var->type = variable_type_numeric;
-    var->is_array = false;
+    slice s = { name, strlen(name) };
+    var = _scalar_new(variable_name_type(s) == variable_type_numeric ? variable_type_numeric : variable_type_integer);
+    if(var==NULL){
+      return NULL;
+    }
   }
-  var->value.num = value;
+  variable_store_numeric(var, value);
   dictionary_put(_dictionary, name, var);
   return var;
 }
@@ -136,224 +428,288 @@ variable_get_type(char* name)
 }
 
 
-// Calculates array size
-//  static size_t
-//calc_array_size(variable* var)
-//{
-//  size_t size = 1;
-//  for(size_t i=0; i<var->nr_dimensions; i++)
-//  {
-//    size *= var->dimensions[i];
-//  }
-//
-//  printf("size = %ld\n", size);
-//
-//  return size;
-//}
-//
-// Calculates array size
-  static size_t
-calc_size(variable* var)
-{
-  size_t size = 1;
-  for(size_t i=0; i<var->nr_dimensions; ++i)
-  {
-    size *= var->dimensions[i];
-  }
-
-  // printf("array size %s = %ld\n", var->name, size);
-
-  return size;
-}
-
-
-  static bool
-check_in_bounds(variable* var, size_t* vector)
-{
-  // printf("check in bounds\n");
-  // printf("dimensions %ld\n", var->nr_dimensions);
-  for(size_t i=0; i<var->nr_dimensions; i++)
-  {
-    size_t vector_i = vector[i];
-    // printf("vector_%ld = %ld\n", i, vector_i);
-    // printf("dimension_%ld = %ld\n", i, var->dimensions[i]); 
-    // DIM A(3) -> A(1), A(2), A(3)
-    if (vector_i > var->dimensions[i])
-    { 
-      return false;
-    }  
-  }
-
-  return true;
-}  
-
 /*
+  Arrays
 
-  DIM A(2,3)
-    w h
-    x y
-  A(1,1) 0 
-  A(1,2) 1 
-  A(1,3) 2 
-  A(2,1) 3 
-  A(2,2) 4 
-  A(2,3) 5 
- 
-  (x*ySize*zSize + y*zSize + z)
+  The elements are stored row major in one block, numbers, integers,
+  bytes, bits or string pointers depending on the type. DIM A(2,3) holds
 
-  v[0] = x
-  v[1] = y
-  v[2] = z
+    A(0,0) A(0,1) A(0,2) A(0,3) A(1,0) ... A(2,3)
 
-  v[0] * d[1] * ... d[n] + v[1] * d[2] ... d[n] + ... + v[n]
+  The stride of a dimension is the number of elements one step in it
+  skips, the product of the sizes of the dimensions after it. They are
+  computed once by DIM, an element is then at
 
+    v[0] * stride[0] + v[1] * stride[1] + ... + v[n]
 
- */
+  One and two dimensional arrays, the common case, take a path of their
+  own. Bit arrays pack eight elements in a byte, DIM F!(9999999) takes
+  1.25 MB where doubles would take 80.
+*/
+
+#define ELEMENT_NONE ((size_t) -1)
 
   static size_t
-calc_index(variable* var, size_t* vector)
+calc_index(array_variable* var, size_t* vector)
 {
-  // printf("calc_index\n");
-  // variable_dump(var);
+  switch (var->nr_dimensions)
+  {
+    case 1:
+      if (vector[0] >= var->dimensions[0])
+      {
+        return ELEMENT_NONE;
+      }
+      return vector[0];
+    case 2:
+      if (vector[0] >= var->dimensions[0] || vector[1] >= var->dimensions[1])
+      {
+        return ELEMENT_NONE;
+      }
+      return vector[0] * var->strides[0] + vector[1];
+    default:
+      break;
+  }
 
   size_t index = 0;
   for(size_t i=0; i<var->nr_dimensions; ++i)
   {
-    // size_t product = vector[i] - 1;
-    size_t product = vector[i];
-    for(size_t j=i+1; j<var->nr_dimensions; ++j)
+    if (vector[i] >= var->dimensions[i])
     {
-      product *= var->dimensions[j];
+      return ELEMENT_NONE;
     }
-    index += product;
+    index += vector[i] * var->strides[i];
   }
-
-  // printf("index[ %s", var->name);
-  // for(size_t i=0; i<var->nr_dimensions; i++){
-  //    printf("%ld", vector[i]);
-  //    if (i<var->nr_dimensions-1) printf(",");
-  // }
-  // printf(") ] = %ld\n", index); 
-
   return index;
 }
 
+  static size_t
+_elements_bytes(variable_type type, size_t size)
+{
+  switch (type)
+  {
+    case variable_type_string:
+      return size * sizeof(char*);
+    case variable_type_integer:
+      return size * sizeof(int32_t);
+    case variable_type_byte:
+      return size;
+    case variable_type_bit:
+      return array_bits_bytes(size);
+    default:
+      return size * sizeof(basic_number);
+  }
+}
+
 variable*
 variable_array_init(char* name, variable_type type, size_t dimensions, size_t* vector)
 {
-  variable* var = (variable*) malloc(sizeof(variable));
-  var->name = C_STRDUP(name);
-  var->is_array = true;
-  var->value.string = NULL;
-  var->value.num = 0;
-  var->type = type;
+  // Dimensioned again, the variable is reused and stays bound
+  array_variable* var = dictionary_get(_dictionary, name);
+  if (var != NULL)
+  {
+    _free_values(&var->header);
+  }
+  else
+  {
+    var = arena_alloc(_pool, sizeof(array_variable));
+    if (var == NULL)
+    {
+      return NULL;
+    }
+  }
+
+  var->header.value.string = NULL;
+  var->header.type = type;
+  var->header.is_array = true;
   var->nr_dimensions = dimensions;
-  var->dimensions[0] = vector[0] + 1;
-  var->dimensions[1] = vector[1] + 1;
-  var->dimensions[2] = vector[2] + 1;
-  var->dimensions[3] = vector[3] + 1;
-  var->dimensions[4] = vector[4] + 1;
-  var->array = array_new(sizeof(variable_value));
-  // array_alloc(var->array, calc_size(var, var->nr_dimensions, -1)); 
-  array_alloc(var->array, calc_size(var)); 
+  size_t size = 1;
+  for(size_t i=dimensions; i-- > 0; )
+  {
+    var->dimensions[i] = vector[i] + 1;
+    var->strides[i] = size;
+    size *= var->dimensions[i];
+  }
+  var->size = size;
+  var->elements = calloc(1, _elements_bytes(type, size));
+  if (var->elements == NULL)
+  {
+    var->size = 0;
+    error("OUT OF MEMORY");
+  }
   dictionary_put(_dictionary, name, var);
-  return var;
+  return &var->header;
 }
 
-variable*
-variable_array_set_string(char *name, char *value, size_t* vector)
+  static size_t
+_element(variable* header, size_t* vector)
 {
-  variable* var = dictionary_get(_dictionary, name);
-  if (var == NULL)
+  if (header == NULL)
   {
     error(E_VAR_NOT_FOUND);
-    return NULL;
+    return ELEMENT_NONE;
   }
 
-  if ( ! check_in_bounds(var, vector) )
+  size_t index = calc_index((array_variable*) header, vector);
+  if (index == ELEMENT_NONE)
   {
     error(E_INDEX_OUT_OF_BOUNDS);
-    return NULL;
   }
+  return index;
+}
 
-  size_t index = calc_index(var, vector); 
-  variable_value val;
-  val.string = C_STRDUP(value);
-  array_set(var->array, index, &val);
-
-  return var;
+  void
+variable_store_element_string(variable* var, slice value, size_t* vector)
+{
+  size_t index = _element(var, vector);
+  if (index == ELEMENT_NONE)
+  {
+    return;
+  }
+  char** element = &((char**) ((array_variable*) var)->elements)[index];
+  char* copy = _copy_slice(value);
+  free(*element);
+  *element = copy;
 }
 
   char*
-variable_array_get_string(char *name, size_t* vector)
+variable_element_string(variable* var, size_t* vector)
 {
-  variable* var = dictionary_get(_dictionary, name);
-  if (var == NULL)
+  size_t index = _element(var, vector);
+  return index != ELEMENT_NONE ? ((char**) ((array_variable*) var)->elements)[index] : NULL;
+}
+
+/*
+  Elements of integer, byte and bit arrays. A byte holds 0 to 255, a bit
+  is set by anything but 0.
+*/
+  static int32_t
+_integer_element(array_variable* var, size_t index)
+{
+  switch (var->header.type)
   {
-    error(E_VAR_NOT_FOUND);
-    return NULL;
+    case variable_type_integer:
+      return ((int32_t*) var->elements)[index];
+    case variable_type_byte:
+      return ((uint8_t*) var->elements)[index];
+    default:
+      return array_bit_get(var->elements, index);
   }
+}
 
-  if ( ! check_in_bounds(var, vector) )
+  static void
+_store_integer_element(array_variable* var, size_t index, int32_t value)
+{
+  switch (var->header.type)
   {
-    error(E_INDEX_OUT_OF_BOUNDS);
-    return NULL;
+    case variable_type_integer:
+      ((int32_t*) var->elements)[index] = value;
+      break;
+    case variable_type_byte:
+      if (value < 0 || value > 255)
+      {
+        error(E_OVERFLOW);
+        return;
+      }
+      ((uint8_t*) var->elements)[index] = value;
+      break;
+    default:
+      array_bit_set(var->elements, index, value != 0);
+      break;
   }
-
-  size_t index = calc_index(var, vector); 
-  variable_value* val = array_get(var->array, index);
-
-  return val->string;
 }
 
-variable*
-variable_array_set_numeric(char *name, float value, size_t* vector)
+  void
+variable_store_element_numeric(variable* var, basic_number value, size_t* vector)
 {
-  // printf("set numeric %s, %f, %ld\n", name, value, vector[0]);
-  variable* var = dictionary_get(_dictionary, name);
-  if (var == NULL)
+  size_t index = _element(var, vector);
+  if (index == ELEMENT_NONE)
   {
-    error(E_VAR_NOT_FOUND);
-    return NULL;
+    return;
   }
-
-  if ( ! check_in_bounds(var, vector) )
+  if (var->type == variable_type_numeric)
   {
-    error(E_INDEX_OUT_OF_BOUNDS);
-    return NULL;
+    ((basic_number*) ((array_variable*) var)->elements)[index] = value;
+  }
+  else
+  {
+    _store_integer_element((array_variable*) var, index, variable_float_to_integer(value));
   }
-
-  // variable_dump(var);
-  size_t index = calc_index(var, vector); 
-  // printf("index = %ld\n", index);
-  variable_value val;
-  val.num = value;
-  array_set(var->array, index, &val);
-  // variable_dump(var);
-  
-  return var;
 }
 
-float
-variable_array_get_numeric(char *name, size_t* vector)
+  basic_number
+variable_element_numeric(variable* var, size_t* vector)
 {
-  variable* var = dictionary_get(_dictionary, name);
-  if (var == NULL)
+  size_t index = _element(var, vector);
+  if (index == ELEMENT_NONE)
   {
-    error(E_VAR_NOT_FOUND);
     return 0;
   }
+  if (var->type == variable_type_numeric)
+  {
+    return ((basic_number*) ((array_variable*) var)->elements)[index];
+  }
+  return _integer_element((array_variable*) var, index);
+}
 
-  if ( ! check_in_bounds(var, vector) )
+  void
+variable_store_element_integer(variable* var, int32_t value, size_t* vector)
+{
+  size_t index = _element(var, vector);
+  if (index == ELEMENT_NONE)
+  {
+    return;
+  }
+  if (var->type == variable_type_numeric)
+  {
+    ((basic_number*) ((array_variable*) var)->elements)[index] = value;
+  }
+  else
+  {
+    _store_integer_element((array_variable*) var, index, value);
+  }
+}
+
+  int32_t
+variable_element_integer(variable* var, size_t* vector)
+{
+  size_t index = _element(var, vector);
+  if (index == ELEMENT_NONE)
   {
-    error(E_INDEX_OUT_OF_BOUNDS);
     return 0;
   }
+  if (var->type == variable_type_numeric)
+  {
+    return variable_float_to_integer(((basic_number*) ((array_variable*) var)->elements)[index]);
+  }
+  return _integer_element((array_variable*) var, index);
+}
+
+variable*
+variable_array_set_string(char *name, slice value, size_t* vector)
+{
+  variable* var = dictionary_get(_dictionary, name);
+  variable_store_element_string(var, value, vector);
+  return var;
+}
+
+  char*
+variable_array_get_string(char *name, size_t* vector)
+{
+  return variable_element_string(dictionary_get(_dictionary, name), vector);
+}
 
-  size_t index = calc_index(var, vector); 
-  variable_value* val = array_get(var->array, index);
+variable*
+variable_array_set_numeric(char *name, basic_number value, size_t* vector)
+{
+  variable* var = dictionary_get(_dictionary, name);
+  variable_store_element_numeric(var, value, vector);
+  return var;
+}
 
-  return val->num;
+basic_number
+variable_array_get_numeric(char *name, size_t* vector)
+{
+  return variable_element_numeric(dictionary_get(_dictionary, name), vector);
 }
 
 struct each_v_ctx
@@ -366,7 +722,7 @@ void each_v(char* name, void* value, void* context)
 {
   struct each_v_ctx* ctx = (struct each_v_ctx*) context;
   variable* var = (variable*) value;
-  ctx->cb(var, ctx->context);
+  ctx->cb(name, var, ctx->context);
 }
 
 void
@@ -383,22 +739,12 @@ variables_each(variables_each_cb each, void* context)
 #if ARCH!=ARCH_XMEGA
 
   static void
-calc_vector(variable* var, size_t index, size_t* vector)
+calc_vector(array_variable* var, size_t index, size_t* vector)
 {
-  size_t product = 1;
-  for(size_t i=1; i<var->nr_dimensions; ++i)
-  {
-    product *= var->dimensions[i];
-  }
-
-  for(int i=0; i<var->nr_dimensions; ++i)
+  for(size_t i=0; i<var->nr_dimensions; ++i)
   {
-    vector[i] = index / product;
-    index %= product;
-    if( (i+1) < var->nr_dimensions )
-    {
-      product /= var->dimensions[i+1];
-    }
+    vector[i] = index / var->strides[i];
+    index %= var->strides[i];
   }
 }  
 
@@ -416,51 +762,63 @@ vector_print(size_t* vector, size_t dimensions)
 }
 
 void
-variable_dump(variable* var)
+variable_dump(char* name, variable* header)
 {
   printf(
     "-- variable\n" 
     "\tname:'%s'\n"
     "\ttype: %s\n",
-      var->name,
-      (var->type == variable_type_numeric) ? "number" : "string"
+      name,
+      (header->type == variable_type_numeric) ? "number" :
+      (header->type == variable_type_integer) ? "integer" :
+      (header->type == variable_type_byte) ? "byte" :
+      (header->type == variable_type_bit) ? "bit" : "string"
   );
 
-  if (var->is_array)
+  if (header->is_array)
   {
+    array_variable* var = (array_variable*) header;
     printf("\tdimensions: %ld\n", var->nr_dimensions);
     for(size_t d=0; d<var->nr_dimensions; d++)
     {    
       printf("\tdim %ld size = %ld\n", d, var->dimensions[d]);
     }
-    printf("\tarray size: %ld\n", array_size(var->array));
-    for(size_t i=0; i<array_size(var->array); i++)
+    printf("\tarray size: %ld\n", var->size);
+    for(size_t i=0; i<var->size; i++)
     {
       size_t vector[5];
       calc_vector(var, i, vector);
-      printf("\t%3ld %s", i, var->name);
+      printf("\t%3ld %s", i, name);
       vector_print(vector, var->nr_dimensions);
       printf(") = ");
-      variable_value* val = array_get(var->array, i);
-      if (var->type == variable_type_string)
+      if (header->type == variable_type_string)
       {
-        printf("%s\n", (val->string) ? val->string : "");
+        char* string = ((char**) var->elements)[i];
+        printf("%s\n", (string) ? string : "");
+      }
+      else if (header->type == variable_type_numeric)
+      {
+        printf("%f\n", ((basic_number*) var->elements)[i]); 
       }
       else
       {
-        printf("%f\n", val->num); 
+        printf("%d\n", (int) _integer_element(var, i));
       }
     }
   }
   else
   {
-    if (var->type == variable_type_numeric)
+    if (header->type == variable_type_numeric)
+    {
+      printf("\tvalue: %f\n", header->value.num);
+    }
+    else if (header->type == variable_type_integer)
     {
-      printf("\tvalue: %f\n", var->value.num);
+      printf("\tvalue: %d\n", (int) header->value.integer);
     }
     else
     {
-      printf("\tvalue: '%s'\n", var->value.string);
+      printf("\tvalue: '%s'\n", header->value.string);
     }
 
   }
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <time.h>
+
+// The modules under test allocate through these, count and forward
+#undef malloc
+#undef calloc
+#undef realloc
+#undef strdup
+#undef free
+
+extern void bench_tokenizer(void);
+extern void bench_lines(void);
+extern void bench_dictionary(void);
+
+volatile uintptr_t bench_sink;
+
+static size_t __allocations = 0;
+
+void* bench_malloc(size_t size)
+{
+  __allocations++;
+  return malloc(size);
+}
+
+void* bench_calloc(size_t count, size_t size)
+{
+  __allocations++;
+  return calloc(count, size);
+}
+
+void* bench_realloc(void* ptr, size_t size)
+{
+  __allocations++;
+  return realloc(ptr, size);
+}
+
+char* bench_strdup(const char* s)
+{
+  __allocations++;
+  return strdup(s);
+}
+
+void bench_free(void* ptr)
+{
+  free(ptr);
+}
+
+size_t bench_allocations(void)
+{
+  return __allocations;
+}
+
+static uint64_t now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void bench_start(bench_timer* timer)
+{
+  timer->allocations = __allocations;
+  timer->start = now();
+}
+
+void bench_stop(bench_timer* timer, char* name, size_t n, size_t ops)
+{
+  uint64_t elapsed = now() - timer->start;
+  size_t allocations = __allocations - timer->allocations;
+  printf("%s,%zu,%zu,%.2f,%.3f\n", name, n, ops,
+      (double) elapsed / ops, (double) allocations / ops);
+  fflush(stdout);
+}
+
+int main(void)
+{
+  printf("benchmark,n,ops,ns_per_op,allocs_per_op\n");
+  bench_tokenizer();
+  bench_lines();
+  bench_dictionary();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef struct {
+  uint64_t start;
+  size_t allocations;
+} bench_timer;
+
+void bench_start(bench_timer* timer);
+
+// Print one CSV record: benchmark,n,ops,ns_per_op,allocs_per_op
+void bench_stop(bench_timer* timer, char* name, size_t n, size_t ops);
+
+size_t bench_allocations(void);
+
+// Keeps results alive, so the compiler can't drop the work being measured
+extern volatile uintptr_t bench_sink;
+
+#endif // __BENCH_H__
@@ -0,0 +1,29 @@
+#ifndef __BENCH_ALLOC_H__
+#define __BENCH_ALLOC_H__
+
+/*
+  Force included (-include) in every source of the benchmark, so the
+  allocations of the modules under test go through the counting wrappers
+  in bench.c.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+void* bench_malloc(size_t size);
+void* bench_calloc(size_t count, size_t size);
+void* bench_realloc(void* ptr, size_t size);
+char* bench_strdup(const char* s);
+void bench_free(void* ptr);
+
+#define malloc bench_malloc
+#define calloc bench_calloc
+#define realloc bench_realloc
+#define strdup bench_strdup
+#define free bench_free
+
+#endif // __BENCH_ALLOC_H__
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <dictionary.h>
+
+static size_t sizes[] = { 16, 256, 4096 };
+
+#define LOOKUPS 200000
+
+  static void
+_keep(char* name, void* value, void* context)
+{
+}
+
+  void
+bench_dictionary(void)
+{
+  for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++)
+  {
+    size_t n = sizes[s];
+    char (*names)[8] = malloc(n * sizeof(*names));
+    char (*misses)[8] = malloc(n * sizeof(*misses));
+    for(size_t i=0; i<n; i++)
+    {
+      // Shaped like BASIC variable names
+      snprintf(names[i], sizeof(names[i]), "%c%zu", 'A' + (int) (i % 26), i / 26);
+      snprintf(misses[i], sizeof(misses[i]), "%c%zu$", 'A' + (int) (i % 26), i / 26);
+    }
+
+    dictionary* d = dictionary_new();
+
+    bench_timer timer;
+    bench_start(&timer);
+    for(size_t i=0; i<n; i++)
+    {
+      dictionary_put(d, names[i], names[i]);
+    }
+    bench_stop(&timer, "dictionary_put", n, n);
+
+    bench_start(&timer);
+    for(size_t i=0; i<LOOKUPS; i++)
+    {
+      bench_sink += (uintptr_t) dictionary_get(d, names[i % n]);
+    }
+    bench_stop(&timer, "dictionary_get/hit", n, LOOKUPS);
+
+    bench_start(&timer);
+    for(size_t i=0; i<LOOKUPS; i++)
+    {
+      bench_sink += (uintptr_t) dictionary_get(d, misses[i % n]);
+    }
+    bench_stop(&timer, "dictionary_get/miss", n, LOOKUPS);
+
+    dictionary_destroy(d, _keep);
+    free(misses);
+    free(names);
+  }
+}
@@ -0,0 +1,132 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <lines.h>
+
+static size_t sizes[] = { 1000, 10000, 60000 };
+
+#define LOOKUPS 10000
+
+  void
+bench_lines(void)
+{
+  for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++)
+  {
+    size_t n = sizes[s];
+    size_t memory_size = n * 32;
+    char* memory = malloc(memory_size);
+    lines_init(memory, memory_size);
+
+    bench_timer timer;
+    bench_start(&timer);
+    for(size_t i=1; i<=n; i++)
+    {
+      char contents[24];
+      snprintf(contents, sizeof(contents), "X=X+%zu", i);
+      lines_store(i, contents);
+    }
+    bench_stop(&timer, "lines_store/append", n, n);
+
+    // Pseudo random, but the same on every run
+    uint32_t seed = 12345;
+    bench_start(&timer);
+    for(size_t i=0; i<LOOKUPS; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      bench_sink += (uintptr_t) lines_get_contents(1 + (seed >> 8) % n);
+    }
+    bench_stop(&timer, "lines_get_contents", n, LOOKUPS);
+
+    bench_start(&timer);
+    size_t count = 0;
+    for(uint16_t number = lines_first(); number != 0; number = lines_next(number))
+    {
+      count++;
+    }
+    bench_sink += count;
+    bench_stop(&timer, "lines_next", n, count);
+
+    bench_start(&timer);
+    count = 0;
+    lines_cursor cursor;
+    for(bool more = lines_cursor_first(&cursor); more; more = lines_cursor_next(&cursor))
+    {
+      count++;
+    }
+    bench_sink += count;
+    bench_stop(&timer, "lines_cursor_next", n, count);
+
+    bench_start(&timer);
+    for(size_t i=0; i<LOOKUPS; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t number = 1 + (seed >> 8) % n;
+      char contents[24];
+      snprintf(contents, sizeof(contents), "Y=Y+%zu", number);
+      lines_store(number, contents);
+    }
+    bench_stop(&timer, "lines_store/replace", n, LOOKUPS);
+
+    // Bulk load the same program, in a shuffled order
+    lines_entry* entries = malloc(n * sizeof(lines_entry));
+    char (*contents)[24] = malloc(n * sizeof(*contents));
+    for(size_t i=0; i<n; i++)
+    {
+      snprintf(contents[i], sizeof(contents[i]), "X=X+%zu", i + 1);
+      entries[i].number = i + 1;
+      entries[i].contents = contents[i];
+    }
+    for(size_t i=n-1; i>0; i--)
+    {
+      seed = seed * 1103515245 + 12345;
+      size_t j = (seed >> 8) % (i + 1);
+      lines_entry swap = entries[i];
+      entries[i] = entries[j];
+      entries[j] = swap;
+    }
+    bench_start(&timer);
+    bench_sink += lines_load(entries, n);
+    bench_stop(&timer, "lines_load", n, n);
+
+    bench_start(&timer);
+    for(size_t i=0; i<LOOKUPS; i++)
+    {
+      // Edits clustered around a spot, like editing in the REPL
+      seed = seed * 1103515245 + 12345;
+      size_t number = n / 2 + (seed >> 8) % 16;
+      lines_store(number, "Z=Z+1");
+    }
+    bench_stop(&timer, "lines_store/local_edit", n, LOOKUPS);
+
+    // Patch a tenth of the program, line by line and as one merge
+    size_t patch = n / 10;
+    for(size_t i=0; i<patch; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      entries[i].number = 1 + (seed >> 8) % n;
+      snprintf(contents[i], sizeof(contents[i]), "P=P+%zu", i);
+      entries[i].contents = contents[i];
+    }
+    bench_start(&timer);
+    for(size_t i=0; i<patch; i++)
+    {
+      lines_store(entries[i].number, entries[i].contents);
+    }
+    bench_stop(&timer, "lines_store/patch", n, patch);
+
+    bench_start(&timer);
+    bench_sink += lines_merge(entries, patch);
+    bench_stop(&timer, "lines_merge/patch", n, patch);
+
+    bench_start(&timer);
+    bench_sink += lines_delete_range(n / 4, 3 * n / 4);
+    bench_stop(&timer, "lines_delete_range", n, n / 2);
+
+    free(contents);
+    free(entries);
+    lines_clear();
+    free(memory);
+  }
+}
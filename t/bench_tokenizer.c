@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <parser.h>
+#include <tokenizer.h>
+
+static char* program[] = {
+  "FOR I=1 TO 100 STEP 2",
+  "PRINT \"THE VALUE OF I IS \";I;\" AND J IS \";J",
+  "IF A>10 AND B<=20 THEN GOSUB 1000",
+  "X=SIN(A)*COS(B)+SQR(C/2.5)-ABS(D)",
+  "A$=LEFT$(B$,3)+MID$(C$,2,4)+RIGHT$(D$,2)",
+  "DATA 1,2,3,4,5,\"SIX\",7.5,8E3",
+  "ON K GOTO 100,200,300,400",
+  "DIM M(10,10): M(I,J)=M(J,I)*0.25",
+  "NEXT I",
+  "REM A COMMENT WITH SOME WORDS IN IT",
+};
+
+#define PROGRAM_LINES (sizeof(program) / sizeof(program[0]))
+#define PASSES 20000
+
+  static size_t
+_lex(char** lines)
+{
+  size_t tokens = 0;
+  for(size_t i=0; i<PROGRAM_LINES; i++)
+  {
+    tokenizer_state state;
+    tokenizer_init(&state, lines[i]);
+    token t;
+    do
+    {
+      t = tokenizer_get_next_token(&state);
+      tokens++;
+    }
+    while ( t != T_EOF && t != T_ERROR );
+  }
+  return tokens;
+}
+
+  static void
+_bench_lex(char* name, char** lines)
+{
+  size_t tokens = _lex(lines);
+  bench_timer timer;
+  bench_start(&timer);
+  for(size_t pass=0; pass<PASSES; pass++)
+  {
+    bench_sink += _lex(lines);
+  }
+  bench_stop(&timer, name, PROGRAM_LINES, tokens * PASSES);
+}
+
+  void
+bench_tokenizer(void)
+{
+  basic_init(1024, 512);
+
+  _bench_lex("tokenizer_get_next_token/text", program);
+
+  char* crunched[PROGRAM_LINES];
+  for(size_t i=0; i<PROGRAM_LINES; i++)
+  {
+    char buffer[256];
+    tokenizer_crunch(program[i], buffer, sizeof(buffer));
+    crunched[i] = strdup(buffer);
+  }
+  _bench_lex("tokenizer_get_next_token/crunched", crunched);
+
+  bench_timer timer;
+  bench_start(&timer);
+  for(size_t pass=0; pass<PASSES / 10; pass++)
+  {
+    for(size_t i=0; i<PROGRAM_LINES; i++)
+    {
+      char buffer[256];
+      bench_sink += tokenizer_crunch(program[i], buffer, sizeof(buffer));
+    }
+  }
+  bench_stop(&timer, "tokenizer_crunch", PROGRAM_LINES, PROGRAM_LINES * (PASSES / 10));
+
+  for(size_t i=0; i<PROGRAM_LINES; i++)
+  {
+    free(crunched[i]);
+  }
+
+  basic_destroy();
+}
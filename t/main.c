@@ -1,13 +1,47 @@
 #include "test.h"
 
 #include <math.h>
+#include <lines.h>
 #include <parser.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 extern void test_dictionary(void **state);
+extern void test_dictionary_grow(void **state);
+extern void test_dictionary_arena(void **state);
+
+extern void test_variables_bind(void **state);
+extern void test_variables_clear(void **state);
+extern void test_variables_scalars(void **state);
+extern void test_variables_arrays(void **state);
+extern void test_variables_integers(void **state);
+extern void test_variables_packed(void **state);
+
+extern void test_tokenizer_cache_hit(void **state);
+extern void test_tokenizer_cache_generation(void **state);
+extern void test_tokenizer_cache_eviction(void **state);
+extern void test_tokenizer_cache_position(void **state);
+
+extern void test_parser_list(void **state);
+extern void test_parser_delete_running(void **state);
+#if defined(_WIN32) || ARCH!=ARCH_XMEGA
+extern void test_parser_jump_cache(void **state);
+#endif
+#ifdef LINES_GROWABLE
+extern void test_parser_image_expanded(void **state);
+extern void test_parser_frames_merge(void **state);
+#endif
 
 extern void test_lines(void **state);
+extern void test_lines_index(void **state);
+extern void test_lines_load(void **state);
+extern void test_lines_cursor(void **state);
+extern void test_lines_growable(void **state);
+extern void test_lines_merge(void **state);
+extern void test_lines_adopt(void **state);
+#ifdef LINES_LONG
+extern void test_lines_long(void **state);
+#endif
 extern int lines_setup(void **state);
 extern int lines_teardown(void **state);
 
@@ -20,8 +54,38 @@ int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_BASIC),
         cmocka_unit_test(test_dictionary),
+        cmocka_unit_test(test_dictionary_grow),
+        cmocka_unit_test(test_dictionary_arena),
+        cmocka_unit_test(test_variables_bind),
+        cmocka_unit_test(test_variables_clear),
+        cmocka_unit_test(test_variables_scalars),
+        cmocka_unit_test(test_variables_arrays),
+        cmocka_unit_test(test_variables_integers),
+        cmocka_unit_test(test_variables_packed),
+        cmocka_unit_test(test_tokenizer_cache_hit),
+        cmocka_unit_test(test_tokenizer_cache_generation),
+        cmocka_unit_test(test_tokenizer_cache_eviction),
+        cmocka_unit_test(test_tokenizer_cache_position),
+        cmocka_unit_test(test_parser_list),
+        cmocka_unit_test(test_parser_delete_running),
+#if defined(_WIN32) || ARCH!=ARCH_XMEGA
+        cmocka_unit_test(test_parser_jump_cache),
+#endif
+#ifdef LINES_GROWABLE
+        cmocka_unit_test(test_parser_image_expanded),
+        cmocka_unit_test(test_parser_frames_merge),
+#endif
         // cmocka_unit_test(test_lines)
-        cmocka_unit_test_setup_teardown(test_lines, lines_setup, lines_teardown)
+        cmocka_unit_test_setup_teardown(test_lines, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_index, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_load, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_cursor, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_growable, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_merge, lines_setup, lines_teardown),
+        cmocka_unit_test_setup_teardown(test_lines_adopt, lines_setup, lines_teardown),
+#ifdef LINES_LONG
+        cmocka_unit_test_setup_teardown(test_lines_long, lines_setup, lines_teardown),
+#endif
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
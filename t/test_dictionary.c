@@ -4,14 +4,14 @@
 
 #include <stdio.h>
 
-void p(char *name, void* value)
+static void p(char *name, void* value, void* context)
 {
   printf("n: %s, v: %p\n", name, value);
 }
 
-void dump(dictionary* d)
+static void dump(dictionary* d)
 {
-  dictionary_each(d, p);
+  dictionary_each(d, p, NULL);
 }
 
 void test_dictionary(void **state)
@@ -37,6 +37,75 @@ void test_dictionary(void **state)
 
   assert_false( dictionary_has(d, "int") );
 
-  dictionary_destroy(d, NULL);
+  dictionary_destroy(d, p);
   
 }
+
+void test_dictionary_grow(void **state)
+{
+  dictionary *d = dictionary_new();
+  assert_non_null( d );
+
+  static int values[1000];
+  char name[16];
+  for(int i=0; i<1000; i++)
+  {
+    snprintf(name, sizeof(name), "%c%d", 'A' + i % 26, i);
+    values[i] = i;
+    dictionary_put(d, name, &values[i]);
+  }
+
+  // Delete every other entry, the rest stays reachable
+  for(int i=0; i<1000; i+=2)
+  {
+    snprintf(name, sizeof(name), "%c%d", 'A' + i % 26, i);
+    assert_ptr_equal( dictionary_del(d, name), &values[i] );
+  }
+  for(int i=0; i<1000; i++)
+  {
+    snprintf(name, sizeof(name), "%c%d", 'A' + i % 26, i);
+    if ( i % 2 )
+    {
+      assert_ptr_equal( dictionary_get(d, name), &values[i] );
+    }
+    else
+    {
+      assert_false( dictionary_has(d, name) );
+      assert_null( dictionary_del(d, name) );
+    }
+  }
+
+  dictionary_put(d, "A0", &values[1]);
+  assert_ptr_equal( dictionary_get(d, "A0"), &values[1] );
+
+  dictionary_destroy(d, NULL);
+}
+
+void test_dictionary_arena(void **state)
+{
+  arena* names = arena_new(256);
+  arena_mark empty = arena_get_mark(names);
+  dictionary *d = dictionary_new_in(names);
+  assert_non_null( d );
+
+  static int values[100];
+  char name[16];
+  for(int round=0; round<2; round++)
+  {
+    for(int i=0; i<100; i++)
+    {
+      snprintf(name, sizeof(name), "V%d", i);
+      dictionary_put(d, name, &values[i]);
+    }
+    assert_ptr_equal( dictionary_del(d, "V7"), &values[7] );
+    assert_ptr_equal( dictionary_get(d, "V99"), &values[99] );
+
+    // Clear the entries, then the names
+    dictionary_clear(d, NULL);
+    arena_reset(names, empty);
+    assert_false( dictionary_has(d, "V99") );
+  }
+
+  dictionary_destroy(d, NULL);
+  arena_destroy(names);
+}
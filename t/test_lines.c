@@ -2,9 +2,12 @@
 
 #include <lines.h>
 
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-static char __memory[1024];
+static char __memory[4096];
 static size_t __memory_size = sizeof(__memory);
 
 int lines_setup(void **state)
@@ -65,28 +68,28 @@ void test_lines(void **state)
     l20->contents, "YYY"
   ); 
  
-  lines_list(out); 
+  lines_list(0, 0, out); 
   */
 
   lines_store(10, "XXXX 10");
   lines_store(20, "XXXX 20");
   lines_store(30, "XXXX 30");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_store(15, "XXXX 15");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_store(20, "XXXX 20.2");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_store(20, "XXXX 20");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_store(5, "XXXX 5");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_store(40, "XXXX 40");
-  lines_list(out);
+  lines_list(0, 0, out);
 
   char* l15 = lines_get_contents( 15 );
   assert_string_equal( l15, "XXXX 15" );
@@ -105,17 +108,335 @@ void test_lines(void **state)
   printf("-- done\n");
 
   lines_delete( 11 );
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_delete( 5 );
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_delete( 40 );
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_delete( 15 );
-  lines_list(out);
+  lines_list(0, 0, out);
 
   lines_clear();
-  lines_list(out);
+  lines_list(0, 0, out);
 }
+
+void test_lines_index(void **state)
+{
+  lines_clear();
+
+  // Store out of order, the index keeps them sorted
+  uint16_t numbers[] = { 50, 10, 40, 20, 30, 60, 5 };
+  for(size_t i=0; i<sizeof(numbers)/sizeof(numbers[0]); i++)
+  {
+    char contents[16];
+    snprintf(contents, sizeof(contents), "LINE %d", numbers[i]);
+    assert_true( lines_store(numbers[i], contents) );
+  }
+
+  assert_int_equal( lines_first(), 5 );
+  assert_int_equal( lines_next(5), 10 );
+  assert_int_equal( lines_next(10), 20 );
+  assert_int_equal( lines_next(35), 40 );
+  assert_int_equal( lines_next(60), 0 );
+  assert_string_equal( lines_get_contents(40), "LINE 40" );
+  assert_null( lines_get_contents(45) );
+
+  // Replace with a longer and a shorter line, the lines after it move
+  assert_true( lines_store(20, "A LONGER LINE 20") );
+  assert_string_equal( lines_get_contents(20), "A LONGER LINE 20" );
+  assert_string_equal( lines_get_contents(30), "LINE 30" );
+  assert_true( lines_store(20, "L20") );
+  assert_string_equal( lines_get_contents(20), "L20" );
+  assert_string_equal( lines_get_contents(60), "LINE 60" );
+
+  assert_true( lines_delete(5) );
+  assert_false( lines_delete(5) );
+  assert_true( lines_delete(40) );
+  assert_int_equal( lines_first(), 10 );
+  assert_int_equal( lines_next(30), 50 );
+  assert_string_equal( lines_get_contents(50), "LINE 50" );
+  assert_null( lines_get_contents(40) );
+
+  // Running out of memory leaves the program as it was
+  char big[200];
+  memset(big, 'X', sizeof(big) - 1);
+  big[sizeof(big) - 1] = '\0';
+  for(uint16_t number = 1000; lines_memory_available() > sizeof(big) + sizeof(line); number++)
+  {
+    assert_true( lines_store(number, big) );
+  }
+  size_t available = lines_memory_available();
+  assert_false( lines_store(999, big) );
+  assert_int_equal( lines_memory_available(), available );
+  assert_string_equal( lines_get_contents(50), "LINE 50" );
+
+  lines_clear();
+  assert_int_equal( lines_first(), 0 );
+}
+
+void test_lines_load(void **state)
+{
+  lines_entry entries[] = {
+    { 30, "LINE 30" },
+    { 10, "LINE 10" },
+    { 20, "FIRST 20" },
+    { 40, "LINE 40" },
+    { 20, "LAST 20" },
+  };
+
+  assert_true( lines_load(entries, sizeof(entries)/sizeof(entries[0])) );
+  assert_int_equal( lines_first(), 10 );
+  assert_int_equal( lines_next(10), 20 );
+  assert_int_equal( lines_next(20), 30 );
+  assert_int_equal( lines_next(40), 0 );
+  assert_string_equal( lines_get_contents(20), "LAST 20" );
+
+  // Edits in the middle move the gap back and forth
+  assert_true( lines_store(25, "LINE 25") );
+  assert_true( lines_store(15, "LINE 15") );
+  assert_true( lines_delete(30) );
+  assert_true( lines_store(35, "LINE 35") );
+  assert_true( lines_store(10, "A LONGER LINE 10") );
+  uint16_t expected[] = { 10, 15, 20, 25, 35, 40 };
+  uint16_t number = lines_first();
+  for(size_t i=0; i<sizeof(expected)/sizeof(expected[0]); i++)
+  {
+    assert_int_equal( number, expected[i] );
+    number = lines_next(number);
+  }
+  assert_int_equal( number, 0 );
+  assert_string_equal( lines_get_contents(10), "A LONGER LINE 10" );
+  assert_string_equal( lines_get_contents(25), "LINE 25" );
+  assert_string_equal( lines_get_contents(40), "LINE 40" );
+
+  lines_clear();
+}
+
+void test_lines_cursor(void **state)
+{
+  lines_cursor cursor;
+  assert_false( lines_cursor_first(&cursor) );
+  assert_null( cursor.contents );
+
+  lines_store(10, "LINE 10");
+  lines_store(20, "LINE 20");
+  lines_store(30, "LINE 30");
+
+  assert_true( lines_cursor_first(&cursor) );
+  assert_int_equal( cursor.number, 10 );
+  assert_string_equal( cursor.contents, "LINE 10" );
+  assert_true( lines_cursor_next(&cursor) );
+  assert_int_equal( cursor.number, 20 );
+
+  // The cursor finds its place again after the program changed
+  lines_store(25, "LINE 25");
+  lines_store(5, "LINE 5");
+  assert_true( lines_cursor_next(&cursor) );
+  assert_int_equal( cursor.number, 25 );
+  assert_string_equal( cursor.contents, "LINE 25" );
+  lines_delete(25);
+  assert_true( lines_cursor_next(&cursor) );
+  assert_int_equal( cursor.number, 30 );
+  assert_false( lines_cursor_next(&cursor) );
+  assert_int_equal( cursor.number, 0 );
+  assert_null( cursor.contents );
+  assert_false( lines_cursor_next(&cursor) );
+
+  assert_true( lines_cursor_seek(&cursor, 20) );
+  assert_string_equal( cursor.contents, "LINE 20" );
+  assert_false( lines_cursor_seek(&cursor, 21) );
+  assert_null( cursor.contents );
+
+  lines_clear();
+}
+
+void test_lines_growable(void **state)
+{
+  assert_true( lines_init_growable(64) );
+
+  char contents[32];
+  for(uint16_t number = 1; number <= 1000; number++)
+  {
+    snprintf(contents, sizeof(contents), "A=A+%d", number);
+    assert_true( lines_store(number, contents) );
+  }
+  assert_int_equal( lines_first(), 1 );
+  assert_string_equal( lines_get_contents(1), "A=A+1" );
+  assert_string_equal( lines_get_contents(500), "A=A+500" );
+  assert_string_equal( lines_get_contents(1000), "A=A+1000" );
+
+  // Growing with the gap in the middle of the program
+  assert_true( lines_delete(500) );
+  for(uint16_t number = 2000; number > 1000; number--)
+  {
+    snprintf(contents, sizeof(contents), "B=B+%d", number);
+    assert_true( lines_store(number, contents) );
+  }
+  assert_string_equal( lines_get_contents(499), "A=A+499" );
+  assert_null( lines_get_contents(500) );
+  assert_string_equal( lines_get_contents(501), "A=A+501" );
+  assert_string_equal( lines_get_contents(1001), "B=B+1001" );
+  assert_string_equal( lines_get_contents(2000), "B=B+2000" );
+
+  // Growing while a program is loaded
+  lines_entry entries[300];
+  static char loaded[300][16];
+  for(size_t i=0; i<300; i++)
+  {
+    snprintf(loaded[i], sizeof(loaded[i]), "C=C+%zu", i);
+    entries[i].number = 300 - i;
+    entries[i].contents = loaded[i];
+  }
+  lines_clear();
+  assert_true( lines_load(entries, 300) );
+  assert_string_equal( lines_get_contents(1), "C=C+299" );
+  assert_string_equal( lines_get_contents(300), "C=C+0" );
+
+  // A limit stops the growth
+  lines_clear();
+  lines_set_limit(1024);
+  uint16_t number = 1;
+  while ( lines_store(number, "A=A+1") )
+  {
+    number++;
+  }
+  assert_true( number > 1 );
+  assert_true( lines_memory_used() <= 1024 );
+  assert_string_equal( lines_get_contents(number - 1), "A=A+1" );
+  lines_set_limit(0);
+  assert_true( lines_store(number, "A=A+1") );
+
+  lines_destroy();
+}
+
+void test_lines_merge(void **state)
+{
+  char contents[16];
+  for(uint16_t number = 10; number <= 100; number += 10)
+  {
+    snprintf(contents, sizeof(contents), "LINE %d", number);
+    assert_true( lines_store(number, contents) );
+  }
+
+  assert_int_equal( lines_delete_range(25, 45), 2 );
+  assert_null( lines_get_contents(30) );
+  assert_null( lines_get_contents(40) );
+  assert_int_equal( lines_next(20), 50 );
+  assert_int_equal( lines_delete_range(41, 49), 0 );
+  assert_int_equal( lines_delete_range(90, 0), 2 );
+  assert_int_equal( lines_next(80), 0 );
+
+  lines_entry entries[] = {
+    { 85, "LINE 85" },
+    { 5, "A MUCH LONGER LINE 5" },
+    { 60, "" },
+    { 20, "20" },
+    { 35, "LINE 35" },
+    { 20, "NEW 20" },
+    { 99, "" },
+  };
+  assert_true( lines_merge(entries, sizeof(entries)/sizeof(entries[0])) );
+
+  uint16_t expected[] = { 5, 10, 20, 35, 50, 70, 80, 85 };
+  uint16_t number = lines_first();
+  for(size_t i=0; i<sizeof(expected)/sizeof(expected[0]); i++)
+  {
+    assert_int_equal( number, expected[i] );
+    number = lines_next(number);
+  }
+  assert_int_equal( number, 0 );
+  assert_string_equal( lines_get_contents(5), "A MUCH LONGER LINE 5" );
+  assert_string_equal( lines_get_contents(10), "LINE 10" );
+  assert_string_equal( lines_get_contents(20), "NEW 20" );
+  assert_string_equal( lines_get_contents(80), "LINE 80" );
+  assert_string_equal( lines_get_contents(85), "LINE 85" );
+
+  // Edits after a merge
+  assert_true( lines_store(15, "LINE 15") );
+  assert_true( lines_delete(50) );
+  assert_int_equal( lines_next(10), 15 );
+  assert_int_equal( lines_next(35), 70 );
+
+  // A merge that doesn't fit leaves the program as it was
+  static char big[sizeof(__memory)];
+  memset(big, 'X', sizeof(big) - 1);
+  lines_entry too_big[] = { { 1, "LINE 1" }, { 2, big } };
+  assert_false( lines_merge(too_big, 2) );
+  assert_null( lines_get_contents(1) );
+  assert_string_equal( lines_get_contents(85), "LINE 85" );
+
+  lines_clear();
+}
+
+static int __released = 0;
+
+static void release(void)
+{
+  __released++;
+}
+
+void test_lines_adopt(void **state)
+{
+  assert_true( lines_init_growable(64) );
+  assert_true( lines_store(30, "LINE 30") );
+  assert_true( lines_store(10, "LINE 10") );
+  assert_true( lines_store(20, "LINE 20") );
+
+  // A packed program and a sentinel make an image
+  char* memory;
+  size_t packed = lines_pack(&memory);
+  size_t size = packed + offsetof(line, contents);
+  char* image = calloc(1, size);
+  memcpy(image, memory, packed);
+
+  assert_false( lines_adopt(image, size - 1, release) );
+  assert_int_equal( lines_first(), 0 );
+
+  assert_true( lines_adopt(image, size, release) );
+  assert_int_equal( lines_first(), 10 );
+  assert_int_equal( lines_next(10), 20 );
+  assert_string_equal( lines_get_contents(30), "LINE 30" );
+
+  // Edits in place, until the program has to grow
+  assert_true( lines_delete(20) );
+  assert_int_equal( __released, 0 );
+  assert_true( lines_store(40, "A LONGER LINE 40") );
+  assert_int_equal( __released, 1 );
+  assert_string_equal( lines_get_contents(10), "LINE 10" );
+  assert_null( lines_get_contents(20) );
+  assert_string_equal( lines_get_contents(40), "A LONGER LINE 40" );
+
+  // A damaged image is refused
+  ((line*) image)->number = 50;
+  assert_false( lines_adopt(image, size, release) );
+  assert_int_equal( lines_first(), 0 );
+
+  free(image);
+  lines_destroy();
+}
+
+#ifdef LINES_LONG
+void test_lines_long(void **state)
+{
+  static char long_line[3000];
+  memset(long_line, 'X', sizeof(long_line) - 1);
+  long_line[sizeof(long_line) - 1] = '\0';
+
+  assert_true( lines_store(10, "LINE 10") );
+  assert_true( lines_store(20, long_line) );
+  assert_true( lines_store(30, "LINE 30") );
+  assert_int_equal( strlen(lines_get_contents(20)), sizeof(long_line) - 1 );
+  assert_int_equal( lines_next(20), 30 );
+  assert_string_equal( lines_get_contents(30), "LINE 30" );
+
+  long_line[1000] = '\0';
+  assert_true( lines_store(20, long_line) );
+  assert_int_equal( strlen(lines_get_contents(20)), 1000 );
+  assert_string_equal( lines_get_contents(30), "LINE 30" );
+
+  lines_clear();
+}
+#endif
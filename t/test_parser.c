@@ -0,0 +1,203 @@
+#include "test.h"
+
+#include <parser.h>
+#include <lines.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char output[512];
+static size_t output_length;
+
+static int out(int ch)
+{
+  if ( output_length + 1 < sizeof(output) )
+  {
+    output[output_length++] = ch;
+    output[output_length] = '\0';
+  }
+  return ch;
+}
+
+static int in(void)
+{
+  return 0;
+}
+
+static void eval(char* line)
+{
+  char buffer[128];
+  strcpy(buffer, line);
+  basic_eval(buffer);
+}
+
+// Run a line, output has what it printed
+static char* eval_output(char* line)
+{
+  output_length = 0;
+  output[0] = '\0';
+  eval(line);
+  return output;
+}
+
+static char* store(char** program, size_t lines, char* text, size_t size)
+{
+  text[0] = '\0';
+  for(size_t i=0; i<lines; i++)
+  {
+    eval(program[i]);
+    if ( strlen(text) + strlen(program[i]) + 2 <= size )
+    {
+      strcat(text, program[i]);
+      strcat(text, "\n");
+    }
+  }
+  return text;
+}
+
+void test_parser_list(void **state)
+{
+  char* program[] = {
+    "10 REM CAFÉ FOR YOU 007",
+    "20 PRINT \"CAFÉ\": X=1",
+    "30 REM \"HALF A STRING, É",
+    "40 Yé=2",
+    "50 REM",
+  };
+
+  basic_init(2048, 512);
+  basic_register_io(out, in);
+
+  char expected[512];
+  store(program, sizeof(program) / sizeof(program[0]), expected, sizeof(expected));
+
+  // A stored line lists back as it was typed
+  assert_string_equal( expected, eval_output("LIST") );
+
+  basic_destroy();
+}
+
+#ifdef LINES_GROWABLE
+void test_parser_image_expanded(void **state)
+{
+  char* program[] = {
+    "10 REM ÉTÉ 007",
+    "20 A$=\"ÉTÉ\": PRINT A$",
+  };
+
+  basic_init(2048, 512);
+  basic_register_io(out, in);
+
+  char expected[512];
+  store(program, sizeof(program) / sizeof(program[0]), expected, sizeof(expected));
+
+  // A plain text image is crunched again on loading
+  eval("BSAVE \"T_EXPANDED\",0");
+  eval("NEW");
+  assert_string_equal( "", eval_output("LIST") );
+  eval("BLOAD \"T_EXPANDED\"");
+  assert_string_equal( expected, eval_output("LIST") );
+  assert_string_equal( "ÉTÉ\n", eval_output("RUN") );
+
+  char* path = getenv("BASIC_PATH");
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/T_EXPANDED.img", path ? path : ".");
+  remove(filename);
+
+  basic_destroy();
+}
+#endif
+
+#ifdef LINES_GROWABLE
+// A file in BASIC_PATH, for LOAD and MERGE
+static void write_program(char* name, char* text)
+{
+  char* path = getenv("BASIC_PATH");
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/%s.bas", path ? path : ".", name);
+  FILE* file = fopen(filename, "w");
+  assert_non_null( file );
+  fputs(text, file);
+  fclose(file);
+}
+
+static void remove_program(char* name)
+{
+  char* path = getenv("BASIC_PATH");
+  char filename[256];
+  snprintf(filename, sizeof(filename), "%s/%s.bas", path ? path : ".", name);
+  remove(filename);
+}
+
+void test_parser_frames_merge(void **state)
+{
+  basic_init(2048, 512);
+  basic_register_io(out, in);
+
+  // MERGE moves the lines a running FOR loop and GOSUB come back to
+  write_program("T_MERGE", "5 REM TWO WORDS\n");
+  eval("10 FOR I=1 TO 2 : MERGE \"T_MERGE\" : PRINT I : NEXT I");
+  eval("20 GOSUB 100 : PRINT \"BACK\"");
+  eval("30 END");
+  eval("100 MERGE \"T_MERGE\" : RETURN");
+  assert_string_equal( "1\n2\nBACK\n", eval_output("RUN") );
+  remove_program("T_MERGE");
+
+  basic_destroy();
+}
+#endif
+
+void test_parser_delete_running(void **state)
+{
+  basic_init(2048, 512);
+  basic_register_io(out, in);
+
+  // The rest of the line is read at its new place, a deleted line stops
+  eval("10 PRINT 1 : DELETE 30 : PRINT 2");
+  eval("20 DELETE 20 : PRINT 3");
+  eval("30 PRINT 4");
+  assert_string_equal( "1\n2\n", eval_output("RUN") );
+  assert_string_equal( "10 PRINT 1 : DELETE 30 : PRINT 2\n", eval_output("LIST") );
+
+  basic_destroy();
+}
+
+// The jump cache is built where JUMP_CACHE_SIZE is set
+#if defined(_WIN32) || ARCH!=ARCH_XMEGA
+extern size_t __jump_seeks;
+
+void test_parser_jump_cache(void **state)
+{
+  basic_init(2048, 512);
+  basic_register_io(out, in);
+
+  eval("10 FOR J=1 TO 2");
+  eval("20 FOR I=1 TO 3");
+  eval("30 ON I GOSUB 100,200,300");
+  eval("40 NEXT I");
+  eval("50 NEXT J");
+  eval("60 END");
+  eval("100 RETURN");
+  eval("200 PRINT \"OLD\" : RETURN");
+  eval("300 RETURN");
+
+  // Every entry of the list is a jump site of its own, each one seeks once
+  size_t seeks = __jump_seeks;
+  assert_string_equal( "OLD\nOLD\n", eval_output("RUN") );
+  assert_int_equal( 3, __jump_seeks - seeks );
+
+  // The targets are still good for the next run
+  seeks = __jump_seeks;
+  assert_string_equal( "OLD\nOLD\n", eval_output("RUN") );
+  assert_int_equal( 0, __jump_seeks - seeks );
+
+  // An edit drops them, the new line is found
+  eval("200 PRINT \"NEW\" : RETURN");
+  seeks = __jump_seeks;
+  assert_string_equal( "NEW\nNEW\n", eval_output("RUN") );
+  assert_int_equal( 3, __jump_seeks - seeks );
+
+  basic_destroy();
+}
+#endif
@@ -0,0 +1,179 @@
+#include "test.h"
+
+#include <parser.h>
+#include <tokenizer.h>
+#include <lines.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// Lines the token cache keeps, see TOKENIZER_CACHE_LINES
+#define CACHE_LINES 16
+
+#define MAX_TOKENS 32
+
+typedef struct
+{
+  size_t count;
+  token tokens[MAX_TOKENS];
+  basic_number numbers[MAX_TOKENS];
+  char* starts[MAX_TOKENS];
+} token_list;
+
+static void read_tokens(tokenizer_state* state, token_list* list)
+{
+  token t;
+  list->count = 0;
+  do
+  {
+    list->starts[list->count] = tokenizer_char_pointer(state, NULL);
+    t = tokenizer_get_next_token(state);
+    list->tokens[list->count] = t;
+    list->numbers[list->count] = t == T_NUMBER ? tokenizer_get_number(state) : 0;
+    list->count++;
+  }
+  while ( t != T_EOF && t != T_ERROR && list->count < MAX_TOKENS );
+}
+
+static void assert_same_tokens(token_list* a, token_list* b)
+{
+  assert_int_equal( a->count, b->count );
+  for(size_t i=0; i<a->count; i++)
+  {
+    assert_int_equal( a->tokens[i], b->tokens[i] );
+    assert_true( a->numbers[i] == b->numbers[i] );
+  }
+}
+
+static char lines[CACHE_LINES + 1][64];
+
+static char* crunched_line(size_t i)
+{
+  char text[32];
+  snprintf(text, sizeof(text), "PRINT %zu + A * 2.5", i);
+  assert_true( tokenizer_crunch(text, lines[i], sizeof(lines[i])) );
+  return lines[i];
+}
+
+void test_tokenizer_cache_hit(void **state)
+{
+  basic_init(2048, 512);
+  tokenizer_cache_clear();
+  uint32_t generation = lines_generation();
+
+  // Lexed from the line itself
+  tokenizer_state lexer;
+  tokenizer_init_crunched(&lexer, crunched_line(0));
+  token_list lexed;
+  read_tokens(&lexer, &lexed);
+  assert_int_equal( T_EOF, lexed.tokens[lexed.count - 1] );
+
+  // Storing decodes the line and replays it right away
+  tokenizer_state tokenizer;
+  assert_false( tokenizer_cache_lookup(&tokenizer, 10, generation) );
+  tokenizer_cache_store(&tokenizer, 10, lines[0], generation);
+  token_list stored;
+  read_tokens(&tokenizer, &stored);
+  assert_same_tokens( &lexed, &stored );
+
+  // A hit replays the same tokens, pointing into the same line
+  assert_true( tokenizer_cache_lookup(&tokenizer, 10, generation) );
+  token_list replayed;
+  read_tokens(&tokenizer, &replayed);
+  assert_same_tokens( &lexed, &replayed );
+  for(size_t i=0; i<lexed.count; i++)
+  {
+    assert_ptr_equal( lexed.starts[i], replayed.starts[i] );
+  }
+
+  tokenizer_cache_clear();
+  basic_destroy();
+}
+
+void test_tokenizer_cache_generation(void **state)
+{
+  basic_init(2048, 512);
+  tokenizer_cache_clear();
+
+  tokenizer_state tokenizer;
+  uint32_t generation = lines_generation();
+  tokenizer_cache_store(&tokenizer, 10, crunched_line(0), generation);
+  assert_true( tokenizer_cache_lookup(&tokenizer, 10, generation) );
+
+  // Storing a line moves the program, the cached lines are gone
+  assert_true( lines_store(20, "X") );
+  assert_true( lines_generation() != generation );
+  assert_false( tokenizer_cache_lookup(&tokenizer, 10, lines_generation()) );
+
+  tokenizer_cache_clear();
+  basic_destroy();
+}
+
+void test_tokenizer_cache_eviction(void **state)
+{
+  basic_init(2048, 512);
+  tokenizer_cache_clear();
+  uint32_t generation = lines_generation();
+
+  tokenizer_state tokenizer;
+  for(size_t i=0; i<CACHE_LINES; i++)
+  {
+    tokenizer_cache_store(&tokenizer, i + 1, crunched_line(i), generation);
+  }
+  for(size_t i=0; i<CACHE_LINES; i++)
+  {
+    assert_true( tokenizer_cache_lookup(&tokenizer, i + 1, generation) );
+  }
+
+  // Line 1 is used again, line 2 is now the least recently used one
+  assert_true( tokenizer_cache_lookup(&tokenizer, 1, generation) );
+  tokenizer_cache_store(&tokenizer, CACHE_LINES + 1, crunched_line(CACHE_LINES), generation);
+
+  assert_false( tokenizer_cache_lookup(&tokenizer, 2, generation) );
+  assert_true( tokenizer_cache_lookup(&tokenizer, 1, generation) );
+  assert_true( tokenizer_cache_lookup(&tokenizer, CACHE_LINES + 1, generation) );
+  for(size_t i=3; i<=CACHE_LINES; i++)
+  {
+    assert_true( tokenizer_cache_lookup(&tokenizer, i, generation) );
+  }
+
+  tokenizer_cache_clear();
+  basic_destroy();
+}
+
+void test_tokenizer_cache_position(void **state)
+{
+  basic_init(2048, 512);
+  tokenizer_cache_clear();
+  uint32_t generation = lines_generation();
+
+  tokenizer_state tokenizer;
+  tokenizer_cache_store(&tokenizer, 1, crunched_line(0), generation);
+  tokenizer_get_next_token(&tokenizer);
+  tokenizer_position position = tokenizer_get_position(&tokenizer);
+  token_list rest;
+  read_tokens(&tokenizer, &rest);
+
+  // While the line is cached, the position replays from there
+  assert_true( tokenizer_set_position(&tokenizer, &position, generation) );
+  token_list again;
+  read_tokens(&tokenizer, &again);
+  assert_same_tokens( &rest, &again );
+
+  // Once its slot holds another line, it is refused
+  for(size_t i=1; i<=CACHE_LINES; i++)
+  {
+    tokenizer_cache_store(&tokenizer, i + 1, crunched_line(i), generation);
+  }
+  assert_false( tokenizer_cache_lookup(&tokenizer, 1, generation) );
+  assert_false( tokenizer_set_position(&tokenizer, &position, generation) );
+
+  // And so it is after the program changed
+  tokenizer_cache_store(&tokenizer, 1, crunched_line(0), generation);
+  tokenizer_get_next_token(&tokenizer);
+  position = tokenizer_get_position(&tokenizer);
+  assert_false( tokenizer_set_position(&tokenizer, &position, generation + 1) );
+
+  tokenizer_cache_clear();
+  basic_destroy();
+}
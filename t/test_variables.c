@@ -0,0 +1,219 @@
+#include "test.h"
+
+#include <variables.h>
+
+#include <string.h>
+
+static slice s(char* string)
+{
+  slice name = { string, strlen(string) };
+  return name;
+}
+
+void test_variables_bind(void **state)
+{
+  assert_true( variables_init() );
+
+  // A slot binds on first use, the name is not looked at again
+  variable* a = variable_bind(0, s("A"), false);
+  assert_non_null( a );
+  variable_store_numeric(a, 42);
+  assert_ptr_equal( a, variable_bind(0, s("?"), false) );
+  assert_true( variable_get_numeric("A") == 42 );
+
+  // Without a slot the name is looked up
+  assert_ptr_equal( a, variable_bind(VARIABLE_NO_SLOT, s("A"), false) );
+
+  variable* b = variable_bind(1, s("B$"), false);
+  variable_store_string(b, s("HELLO"));
+  assert_string_equal( "HELLO", variable_get_string("B$") );
+
+  // Arrays share the slot of the scalar with the same name
+  assert_null( variable_bind(0, s("A"), true) );
+  size_t vector[5] = { 3, 0, 0, 0, 0 };
+  variable_array_init("A(", variable_type_numeric, 1, vector);
+  variable* array = variable_bind(0, s("A"), true);
+  assert_non_null( array );
+  vector[0] = 2;
+  variable_store_element_numeric(array, 7, vector);
+  assert_true( variable_array_get_numeric("A(", vector) == 7 );
+  assert_ptr_equal( a, variable_bind(0, s("A"), false) );
+
+  // Dimensioned again, the slot follows
+  vector[0] = 5;
+  variable_array_init("A(", variable_type_numeric, 1, vector);
+  variable* grown = variable_bind(0, s("A"), true);
+  vector[0] = 2;
+  assert_true( variable_element_numeric(grown, vector) == 0 );
+
+  // Unbound slots find the variables by name again
+  variables_unbind();
+  assert_ptr_equal( b, variable_bind(0, s("B$"), false) );
+  assert_string_equal( "HELLO", variable_string(b) );
+
+  variables_destroy();
+}
+
+void test_variables_clear(void **state)
+{
+  assert_true( variables_init() );
+
+  size_t vector[5] = { 2, 0, 0, 0, 0 };
+  for(int round=0; round<3; round++)
+  {
+    variable_set_numeric("A", 1);
+    variable_set_string("B$", s("TEXT"));
+    variable_array_init("C$(", variable_type_string, 1, vector);
+    variable_array_set_string("C$(", s("ELEMENT"), vector);
+    variable* d = variable_bind(0, s("D"), false);
+    variable_store_numeric(d, 4);
+
+    variables_clear();
+
+    assert_null( variable_get("A") );
+    assert_null( variable_get("B$") );
+    assert_null( variable_get("C$(") );
+    // The slot is unbound, the name is looked up again
+    assert_true( variable_numeric(variable_bind(0, s("D"), false)) == 0 );
+  }
+
+  variables_destroy();
+}
+
+void test_variables_scalars(void **state)
+{
+  assert_true( variables_init() );
+
+  // Scalars sit next to each other, arrays and names go elsewhere
+  size_t vector[5] = { 10, 0, 0, 0, 0 };
+  variable* a = variable_set_numeric("A", 1);
+  variable_array_init("A(", variable_type_numeric, 1, vector);
+  variable* b = variable_set_string("LONGER_NAME$", s("B"));
+  variable* c = variable_set_numeric("C", 3);
+  assert_int_equal( (char*) b - (char*) a, 2 * sizeof(void*) );
+  assert_int_equal( (char*) c - (char*) b, 2 * sizeof(void*) );
+
+  assert_true( variable_get_type("A") == variable_type_numeric );
+  assert_true( variable_get_type("LONGER_NAME$") == variable_type_string );
+  assert_true( variable_numeric(c) == 3 );
+
+  // Loops keep the address of their variable
+  basic_number* storage = variable_numeric_storage(c);
+  *storage += 1;
+  assert_true( variable_get_numeric("C") == 4 );
+
+  variables_destroy();
+}
+
+void test_variables_arrays(void **state)
+{
+  assert_true( variables_init() );
+
+  // DIM A(2,3,1)
+  size_t shape[5] = { 2, 3, 1, 0, 0 };
+  variable* a = variable_array_init("A(", variable_type_numeric, 3, shape);
+  size_t vector[5] = { 0, 0, 0, 0, 0 };
+  for(size_t x=0; x<=2; x++)
+  {
+    for(size_t y=0; y<=3; y++)
+    {
+      for(size_t z=0; z<=1; z++)
+      {
+        vector[0] = x; vector[1] = y; vector[2] = z;
+        variable_store_element_numeric(a, x * 100 + y * 10 + z, vector);
+      }
+    }
+  }
+  vector[0] = 1; vector[1] = 2; vector[2] = 1;
+  assert_true( variable_element_numeric(a, vector) == 121 );
+  vector[0] = 2; vector[1] = 3; vector[2] = 0;
+  assert_true( variable_element_numeric(a, vector) == 230 );
+
+  // DIM M(3,4), the two dimensional path
+  size_t matrix[5] = { 3, 4, 0, 0, 0 };
+  variable* m = variable_array_init("M(", variable_type_numeric, 2, matrix);
+  vector[0] = 3; vector[1] = 4; vector[2] = 0;
+  variable_store_element_numeric(m, 34, vector);
+  assert_true( variable_element_numeric(m, vector) == 34 );
+  vector[0] = 0;
+  assert_true( variable_element_numeric(m, vector) == 0 );
+
+  // DIM S$(2)
+  size_t line[5] = { 2, 0, 0, 0, 0 };
+  variable* strings = variable_array_init("S$(", variable_type_string, 1, line);
+  vector[0] = 2; vector[1] = 0;
+  assert_null( variable_element_string(strings, vector) );
+  variable_store_element_string(strings, s("TWO"), vector);
+  variable_store_element_string(strings, s("TWICE"), vector);
+  assert_string_equal( "TWICE", variable_element_string(strings, vector) );
+
+  variables_destroy();
+}
+
+void test_variables_integers(void **state)
+{
+  assert_true( variables_init() );
+
+  variable* i = variable_bind(0, s("I%"), false);
+  variable_store_integer(i, 16777217);
+  assert_true( variable_integer(i) == 16777217 );
+
+  // Numbers are truncated on the way in
+  variable_store_numeric(i, -2.75);
+  assert_true( variable_integer(i) == -2 );
+  assert_true( variable_numeric(i) == -2 );
+
+  // DIM C%(3)
+  size_t shape[5] = { 3, 0, 0, 0, 0 };
+  variable* c = variable_array_init("C%(", variable_type_integer, 1, shape);
+  size_t vector[5] = { 3, 0, 0, 0, 0 };
+  variable_store_element_integer(c, 2147483647, vector);
+  assert_true( variable_element_integer(c, vector) == 2147483647 );
+  variable_store_element_numeric(c, 9.5, vector);
+  assert_true( variable_element_integer(c, vector) == 9 );
+
+  variables_destroy();
+}
+
+void test_variables_packed(void **state)
+{
+  assert_true( variables_init() );
+
+  // DIM F!(99), thirteen bytes of bits
+  size_t shape[5] = { 99, 0, 0, 0, 0 };
+  variable* flags = variable_array_init("F!(", variable_type_bit, 1, shape);
+  size_t vector[5] = { 0, 0, 0, 0, 0 };
+  for(size_t i=0; i<=99; i+=3)
+  {
+    vector[0] = i;
+    variable_store_element_integer(flags, 7, vector);
+  }
+  vector[0] = 98;
+  variable_store_element_numeric(flags, 0, vector);
+  for(size_t i=0; i<=99; i++)
+  {
+    vector[0] = i;
+    assert_true( variable_element_integer(flags, vector) == ( i % 3 == 0 && i != 98 ) );
+  }
+
+  // DIM B@(3)
+  shape[0] = 3;
+  variable* bytes = variable_array_init("B@(", variable_type_byte, 1, shape);
+  vector[0] = 1;
+  variable_store_element_integer(bytes, 255, vector);
+  vector[0] = 2;
+  variable_store_element_numeric(bytes, 12.5, vector);
+  assert_true( variable_element_numeric(bytes, vector) == 12 );
+  vector[0] = 1;
+  assert_true( variable_element_integer(bytes, vector) == 255 );
+  vector[0] = 0;
+  assert_true( variable_element_integer(bytes, vector) == 0 );
+
+  // Their scalars are integers
+  assert_true( variable_name_type(s("B@")) == variable_type_byte );
+  variable* b = variable_bind(VARIABLE_NO_SLOT, s("B@"), false);
+  variable_store_numeric(b, 300.75);
+  assert_true( variable_integer(b) == 300 );
+
+  variables_destroy();
+}